@@ -0,0 +1,92 @@
+#ifndef PSANA_CHECKPOINT_H
+#define PSANA_CHECKPOINT_H
+
+//--------------------------------------------------------------------------
+// File and Version Information:
+//     $Id$
+//
+// Description:
+//     Class Checkpoint.
+//
+//------------------------------------------------------------------------
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+
+//----------------------
+// Base Class Headers --
+//----------------------
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+
+//------------------------------------
+// Collaborating Class Declarations --
+//------------------------------------
+
+//             ---------------------
+//             -- Class Interface --
+//             ---------------------
+
+namespace psana {
+
+/// @addtogroup psana
+
+/**
+ *  @ingroup psana
+ *
+ *  @brief State of the job saved at calib cycle boundary.
+ *
+ *  Checkpoint keeps input position in the form accepted by
+ *  RandomAccess::jump() and setrun(), and state of every user module
+ *  (see Module::saveCheckpoint()) keyed by module name. It is written by
+ *  EventLoop after EndCalibCycle and read back when the job is restarted.
+ *  File is written under a temporary name unique to the process and then
+ *  renamed so that a job which dies while writing leaves previous
+ *  checkpoint intact.
+ *
+ *  This software was developed for the LCLS project.  If you use all or
+ *  part of it, please give an appropriate acknowledgment.
+ *
+ *  @version $Id$
+ *
+ *  @author Andy Salnikov
+ */
+
+class Checkpoint {
+public:
+
+  // Default constructor
+  Checkpoint() : run(0), filenames(), offsets(), lastBeginCalibCycleDgram(), moduleStates() {}
+
+  /**
+   *  @brief Save checkpoint to a file, replacing existing file.
+   *
+   *  @throw ExceptionErrno if file cannot be written
+   */
+  void write(const std::string& path) const;
+
+  /**
+   *  @brief Read checkpoint from a file.
+   *
+   *  @return false if file does not exist
+   *  @throw ExceptionAbort if file has wrong format or is truncated
+   */
+  bool read(const std::string& path);
+
+  int run;                                        ///< Run number for RandomAccess::setrun()
+  std::vector<std::string> filenames;             ///< Input files for RandomAccess::jump()
+  std::vector<int64_t> offsets;                   ///< Offset in every file
+  std::string lastBeginCalibCycleDgram;           ///< BeginCalibCycle datagram preceding offsets
+  std::map<std::string, std::string> moduleStates;  ///< Module state for every module name
+};
+
+} // namespace psana
+
+#endif // PSANA_CHECKPOINT_H
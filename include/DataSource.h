@@ -81,6 +81,11 @@ public:
              const std::vector<boost::shared_ptr<Module> >& modules,
              const boost::shared_ptr<PSEnv::Env>& env);
 
+  /**
+   *  @brief Make an instance of data source from existing event loop.
+   */
+  explicit DataSource(const boost::shared_ptr<EventLoop>& evtLoop);
+
   // Destructor
   ~DataSource();
 
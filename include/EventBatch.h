@@ -0,0 +1,115 @@
+#ifndef PSANA_EVENTBATCH_H
+#define PSANA_EVENTBATCH_H
+
+//--------------------------------------------------------------------------
+// File and Version Information:
+//     $Id$
+//
+// Description:
+//     Class EventBatch.
+//
+//------------------------------------------------------------------------
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+
+//----------------------
+// Base Class Headers --
+//----------------------
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+#include "PSEvt/Event.h"
+
+//------------------------------------
+// Collaborating Class Declarations --
+//------------------------------------
+
+//             ---------------------
+//             -- Class Interface --
+//             ---------------------
+
+namespace psana {
+
+/// @addtogroup psana
+
+/**
+ *  @ingroup psana
+ *
+ *  @brief Sequence of consecutive regular events from one calib cycle.
+ *
+ *  Batch is passed to Module::eventBatch() when psana runs in batch mode
+ *  (psana.batch-size option). In addition to events it keeps skip flag
+ *  for every event; modules which want to skip some events in a batch
+ *  call skip() with the index of the event.
+ *
+ *  This software was developed for the LCLS project.  If you use all or
+ *  part of it, please give an appropriate acknowledgment.
+ *
+ *  @version $Id$
+ *
+ *  @author Andy Salnikov
+ */
+
+class EventBatch : boost::noncopyable {
+public:
+
+  typedef boost::shared_ptr<PSEvt::Event> EventPtr;
+
+  /// Constructor takes the list of events, none of them is skipped
+  explicit EventBatch(const std::vector<EventPtr>& events);
+
+  // Destructor
+  ~EventBatch();
+
+  /// Returns number of events in a batch
+  unsigned size() const { return m_events.size(); }
+
+  /// Returns event with given index
+  PSEvt::Event& event(unsigned i) const { return *m_events[i]; }
+
+  /// Returns pointer to event with given index
+  const EventPtr& eventPtr(unsigned i) const { return m_events[i]; }
+
+  /// Returns true if event with given index was skipped
+  bool skipped(unsigned i) const { return m_skipped[i]; }
+
+  /// Returns number of skipped events
+  unsigned nSkipped() const { return m_nSkipped; }
+
+  /**
+   *  @brief Mark event as skipped.
+   *
+   *  Same as calling Module::skip() from Module::event() for this event,
+   *  modules following current one will not see this event unless they
+   *  observe all events. Like in per-event mode the "__psana_skip_event__"
+   *  key is not added here, ModuleChain adds it before the event is passed
+   *  to a module which observes all events.
+   */
+  void skip(unsigned i);
+
+  /**
+   *  @brief Remove events from the end of the batch.
+   *
+   *  Used when module requests stop, events starting at given index are
+   *  discarded.
+   */
+  void truncate(unsigned size);
+
+protected:
+
+private:
+
+  std::vector<EventPtr> m_events;
+  std::vector<bool> m_skipped;
+  unsigned m_nSkipped;
+};
+
+} // namespace psana
+
+#endif // PSANA_EVENTBATCH_H
@@ -0,0 +1,125 @@
+#ifndef PSANA_EVENTJOIN_H
+#define PSANA_EVENTJOIN_H
+
+//--------------------------------------------------------------------------
+// File and Version Information:
+// 	$Id$
+//
+// Description:
+//	Class EventJoin.
+//
+//------------------------------------------------------------------------
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+#include <utility>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+//----------------------
+// Base Class Headers --
+//----------------------
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+#include "psana/EventIter.h"
+#include "PSEvt/Event.h"
+
+//------------------------------------
+// Collaborating Class Declarations --
+//------------------------------------
+
+//		---------------------
+// 		-- Class Interface --
+//		---------------------
+
+namespace psana {
+
+/// @addtogroup psana
+
+/**
+ *  @ingroup psana
+ *
+ *  @brief Iterator over pairs of matching events from two event streams.
+ *
+ *  Two streams recorded in parallel (e.g. two DAQ partitions) are read
+ *  sequentially and merged by event time. Events match if their fiducials
+ *  are equal and their times differ by no more than tolerance. When events
+ *  do not match, the one with earlier time is dropped and the next event is
+ *  read from its stream. Both streams must be ordered in time, which is
+ *  the case for events of one run. No random access is needed, so this is
+ *  much faster than looking up every event of one stream with Index::jump().
+ *
+ *  Event time is taken from PSEvt::EventId, events without id are dropped.
+ *
+ *  @code
+ *  EventJoin join(ds1.events(), ds2.events(), 1000);
+ *  while (true) {
+ *    EventJoin::value_type evts = join.next();
+ *    if (not evts.first) break;
+ *    ...
+ *  }
+ *  @endcode
+ *
+ *  This software was developed for the LCLS project.  If you use all or
+ *  part of it, please give an appropriate acknowledgment.
+ *
+ *  @version $Id$
+ *
+ *  @author Andy Salnikov
+ */
+
+class EventJoin {
+public:
+
+  typedef std::pair<boost::shared_ptr<PSEvt::Event>, boost::shared_ptr<PSEvt::Event> > value_type;
+
+  /**
+   *  @brief Constructor takes iterators for two streams.
+   *
+   *  @param[in] iter1      Events of the first stream
+   *  @param[in] iter2      Events of the second stream
+   *  @param[in] tolerance  Maximum difference of event times in nanoseconds
+   */
+  EventJoin(const EventIter& iter1, const EventIter& iter2, uint64_t tolerance = 0);
+
+  // Destructor
+  ~EventJoin();
+
+  /// get next pair of matching events, returns pair of zero pointers when done
+  value_type next();
+
+  /// Returns number of events from the first stream which were read and did not match
+  unsigned long nUnmatched1() const { return m_nUnmatched1; }
+
+  /// Returns number of events from the second stream which were read and did not match
+  unsigned long nUnmatched2() const { return m_nUnmatched2; }
+
+protected:
+
+private:
+
+  // Event with its time
+  struct TimedEvent {
+    boost::shared_ptr<PSEvt::Event> evt;
+    uint64_t time;         ///< Time in nanoseconds
+    unsigned fiducial;
+  };
+
+  // Read next event which has event id from a stream, returns false at the end
+  bool read(EventIter& iter, TimedEvent& evt, unsigned long& nDropped);
+
+  // Data members
+  EventIter m_iter1;
+  EventIter m_iter2;
+  uint64_t m_tolerance;
+  unsigned long m_nUnmatched1;
+  unsigned long m_nUnmatched2;
+
+};
+
+} // namespace psana
+
+#endif // PSANA_EVENTJOIN_H
@@ -16,6 +16,7 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/utility.hpp>
 #include <deque>
+#include <string>
 #include <vector>
 #include <utility>
 
@@ -39,6 +40,9 @@
 namespace psana {
 class InputIter;
 class InputModule;
+class ModuleChain;
+class ModuleProfiler;
+class ThreadPool;
 }
 
 //             ---------------------
@@ -120,12 +124,34 @@ public:
    */
   void putback(const value_type& value) { m_values.push_front(value); }
 
+  /**
+   *  @brief Returns next transition skipping all regular events before it.
+   *
+   *  Regular events up to the next transition are discarded without calling
+   *  user modules, input module is asked to skip them without reading their
+   *  data if it can (see InputModule::skipToTransition()). Modules still see
+   *  all transitions. Returned value has type None at the end.
+   */
+  value_type nextTransition();
+
+  /**
+   *  @brief Returns next transition or a group of regular events.
+   *
+   *  If next item is a transition then it is returned as a single element
+   *  of the events vector. For regular events vector is filled with all
+   *  consecutive regular events which are already processed by modules,
+   *  in batch mode this is normally a whole batch. Returned value is the
+   *  type of the returned events, None at the end (events vector is empty
+   *  in this case).
+   */
+  EventType nextBatch(std::vector<EventPtr>& events);
+
 
   /*
    * @breif Add a PSANA module to list of modules
    *
    */
-  void addmodule(boost::shared_ptr<Module> module) { m_modules.push_back(module); }
+  void addmodule(boost::shared_ptr<Module> module);
 
 
   // Returns True if live mode and the available events > numEvents arg
@@ -137,31 +163,338 @@ public:
 
   RandomAccess& randomAccess();
 
+  /**
+   *  @brief Enable collection of timing statistics for user modules.
+   *
+   *  Wall-clock and CPU time is measured for every call of every module
+   *  method, at EndJob the table with the statistics is printed and
+   *  optionally saved to a file. Must be called before first call to next().
+   *
+   *  @param[in] dumpFile  If not empty then statistics table is also saved in this file.
+   */
+  void enableProfiling(const std::string& dumpFile = std::string());
+
+  /**
+   *  @brief Read input data in a background thread.
+   *
+   *  Keeps up to depth events read and decoded by input module ahead of
+   *  the event being processed by user modules, zero disables read-ahead.
+   *  Ignored if input module updates environment for regular events (see
+   *  InputModule::updatesEnv()). Must be called before first call to next().
+   */
+  void setReadAhead(unsigned depth);
+
+  /**
+   *  @brief Process regular events in several threads.
+   *
+   *  When nThreads is greater than one, at BeginJob the module chain is
+   *  copied (see Module::clone()) so that every thread has its own copy.
+   *  Consecutive regular events are read in batches, events in a batch are
+   *  shared between threads and are returned from next() in the original
+   *  order after all events in the batch are processed. Transitions are
+   *  passed to all copies of the chain, original chain first. If some module
+   *  does not support cloning, or if input module updates environment for
+   *  regular events (see InputModule::updatesEnv()), then events are
+   *  processed in a single thread. When a module requests stop for some
+   *  event threads do not start any following event of the batch, but
+   *  following events which other threads already started are processed
+   *  to the end; they are not returned from next() and their number is
+   *  reported. Must be called before first call to next().
+   */
+  void setThreads(unsigned nThreads) { m_nThreads = nThreads; }
+
+  /**
+   *  @brief Run independent modules concurrently for each regular event.
+   *
+   *  When nThreads is greater than one, modules which declare data that
+   *  they consume and produce (see Module::consumes()) are called in
+   *  parallel if they do not depend on each other. Not used together with
+   *  setThreads(), multi-threaded event processing takes precedence.
+   *  Must be called before first call to next().
+   */
+  void setModuleThreads(unsigned nThreads) { m_moduleThreads = nThreads; }
+
+  /**
+   *  @brief Run beginRun() and beginCalibCycle() of independent modules concurrently.
+   *
+   *  When nThreads is greater than one, begin transitions of modules which
+   *  declare their data dependencies (see Module::consumes()) are called in
+   *  parallel if modules do not depend on each other, e.g. to read
+   *  calibrations for several detectors at the same time. Modules which
+   *  add data to the transition event or to environment stores (e.g.
+   *  calibStore()) must declare it with Module::produces(), such modules
+   *  are called one at a time. All modules finish before next event is
+   *  processed. Must be called before first call to next().
+   */
+  void setBeginThreads(unsigned nThreads) { m_beginThreads = nThreads; }
+
+  /**
+   *  @brief Process regular events in batches.
+   *
+   *  When batchSize is greater than one, up to batchSize consecutive
+   *  regular events from one calib cycle are collected and passed to
+   *  Module::eventBatch() of every module. Modules are called sequentially
+   *  in this mode, setModuleThreads() is ignored, and setThreads() takes
+   *  precedence over it. All events of a batch are read before modules are
+   *  called, so if input module updates environment for every event (see
+   *  InputModule::updatesEnv()) batch mode is only used when every module
+   *  overrides Module::eventBatch(). Must be called before first call to next().
+   */
+  void setBatchSize(unsigned batchSize) { m_batchSize = batchSize; }
+
+  /**
+   *  @brief Add "__psana_skip_event__" key to skipped events returned from next().
+   *
+   *  Modules signal skipped events to each other without updating the event,
+   *  the key is only added before a skipped event is passed to a module which
+   *  observes all events. Returned events get the key too unless this is
+   *  disabled, which is only safe if the code which iterates over events
+   *  does not look for the key. Enabled by default.
+   */
+  void setSkipEventKey(bool skipEventKey) { m_skipEventKey = skipEventKey; }
+
+  /**
+   *  @brief Keep several reads in flight for asynchronous input modules.
+   *
+   *  See InputIter::setAsyncDepth(). Must be called before first call to next().
+   */
+  void setAsyncDepth(unsigned depth);
+
+  /**
+   *  @brief Reuse event objects after they are released.
+   *
+   *  Up to size released events are kept by the input iterator and reused
+   *  for new events, zero disables reuse. Pool statistics are printed at
+   *  EndJob.
+   */
+  void setEventPoolSize(unsigned size);
+
+  /**
+   *  @brief Set modules which filter events before they are fully read.
+   *
+   *  Input module is asked to read only light part of every event (see
+   *  InputModule::eventHeader()), then event() method of early filter
+   *  modules is called. If any of them calls skip() the event is discarded
+   *  without reading the rest of it and regular modules never see it;
+   *  otherwise remaining data are read and event is passed to regular
+   *  modules. Early filters receive all transitions before regular modules.
+   *  Must be called before first call to next().
+   */
+  void setEarlyFilters(const std::vector<boost::shared_ptr<Module> >& modules);
+
+  /**
+   *  @brief Cache products of cacheable modules on disk.
+   *
+   *  Products of regular modules which declared themselves cacheable are
+   *  stored in given directory and restored on later passes over the same
+   *  data instead of calling module's event() (see ModuleChain::setProductCache()).
+   *  Every process writes its own cache files, several jobs or workers can
+   *  share the directory. Cache statistics are printed at EndJob. Empty directory disables the
+   *  cache. Must be called before first call to next().
+   */
+  void setProductCache(const std::string& dir);
+
+  /**
+   *  @brief Set time budgets for processing of regular events.
+   *
+   *  Meant for live monitoring which needs to keep pace with DAQ. If a
+   *  module spends more than moduleBudget milliseconds in event() method,
+   *  or if all modules together spend more than eventBudget milliseconds
+   *  on one event, then the event is marked as skipped for the remaining
+   *  modules (except those which observe all events). Zero disables
+   *  corresponding budget. Numbers of overruns are printed at every EndRun.
+   *  Must be called before first call to next().
+   */
+  void setTimeBudget(double moduleBudget, double eventBudget);
+
+  /**
+   *  @brief Keep processing close to the newest data in live mode.
+   *
+   *  When maxLag is positive, before passing each regular event to modules
+   *  the input module is asked (see InputModule::liveAvail()) whether more
+   *  than maxLag events are already available; if so the event is dropped
+   *  without calling any module, so processing catches up with the latest
+   *  data. Number of dropped events is printed at every EndRun. This is not
+   *  used when read-ahead is enabled because input module would be called
+   *  from two threads. Must be called before first call to next().
+   */
+  void setLiveMaxLag(unsigned maxLag) { m_liveMaxLag = maxLag; }
+
+  /**
+   *  @brief Add one more independent chain of modules.
+   *
+   *  Every event read from input is passed to the regular modules and then
+   *  to every additional chain in the order in which they were added, so
+   *  that several analyses share one pass over the data. Each chain has its
+   *  own Skip state, skip flag in the event is reset before each chain and
+   *  event returned from next() reflects the regular modules only. When a
+   *  chain requests stop it does not receive more events but still gets all
+   *  transitions; input finishes after all chains, including the regular
+   *  one, requested stop. Abort from any chain aborts the job. Every chain
+   *  sees input data and data added by regular modules, data added by a
+   *  chain is removed from event after the chain is called so that chains
+   *  do not see each other's products and may contain the same modules.
+   *  Modules of a chain must not declare (Module::produces()) keys produced
+   *  by regular modules, ExceptionAbort is thrown in that case or if chain
+   *  name is not unique. Additional chains are called in the thread which
+   *  calls next(), profiling and time budgets only apply to regular modules.
+   *  Must be called after setEarlyFilters() and before first call to next().
+   *
+   *  @param[in] name     Chain name used in messages
+   *  @param[in] modules  Modules of this chain
+   */
+  void addChain(const std::string& name, const std::vector<boost::shared_ptr<Module> >& modules);
+
+  /// Returns number of events dropped in current run to catch up with live data
+  unsigned long liveDropped() const { return m_liveDropped; }
+
+  /**
+   *  @brief Periodically save checkpoint which allows restarting the job.
+   *
+   *  After every interval-th EndCalibCycle the input position (see
+   *  InputModule::resumePosition()) and state of every module (see
+   *  Module::saveCheckpoint()) are written to given file. If input module
+   *  cannot report its position checkpointing is disabled with a warning.
+   *  Checkpoints are not written when read-ahead or asynchronous reads are
+   *  enabled because input position is ahead of processed data, and in
+   *  multi-threaded mode because state is split between copies of modules.
+   *  State of modules in additional chains and early filters is keyed by
+   *  chain and module name. Empty path disables checkpointing. Must be
+   *  called before first call to next().
+   */
+  void setCheckpoint(const std::string& path, unsigned interval = 1);
+
+  /**
+   *  @brief Resume processing from checkpoint saved by earlier job.
+   *
+   *  After all modules finished beginJob() the checkpoint is read, module
+   *  state is restored with Module::loadCheckpoint() and input is moved to
+   *  saved position with RandomAccess::setrun() and RandomAccess::jump(), so
+   *  input module must support random access. If checkpoint file does not
+   *  exist the job starts from the beginning. Not supported in multi-threaded
+   *  mode, ExceptionAbort is thrown at BeginJob. Must be called before first
+   *  call to next().
+   */
+  void setResume(const std::string& path) { m_resumeFile = path; }
+
+  /**
+   *  @brief Read only events in time window [tmin, tmax) of every run.
+   *
+   *  After every BeginRun the window is passed to Index::select() of the
+   *  input module. ExceptionAbort is thrown if input module does not
+   *  support indexing or time windows, or if read-ahead or asynchronous
+   *  reads are enabled as events following BeginRun are already read then.
+   *  Must be called before first call to next().
+   */
+  void setTimeWindow(const EventTime& tmin, const EventTime& tmax);
+
 
 protected:
 
 private:
 
-  enum {NumEventTypes = None+1};
-  
-  typedef void (Module::*ModuleMethod)(PSEvt::Event& evt, PSEnv::Env& env);
+  /// Returns next transition or event from input, modules are not called yet
+  value_type nextInput();
 
   /**
-   *  Calls a method on all modules and returns summary  status.
+   *  Calls a method on all modules and returns summary status.
    *
-   *  @param[in] modules  List of modules
-   *  @param[in] method   Pointer to the member function
+   *  @param[in] evtType  Event type which defines method to call
    *  @param[in] evt      Event object
-   *  @param[in] env      Environment object
-   *  @param[in] ignoreSkip Should be set to false for event() method, true for all others
    */
-  Module::Status callModuleMethod(ModuleMethod method, PSEvt::Event& evt, PSEnv::Env& env, bool ignoreSkip);
+  Module::Status callModuleMethod(EventType evtType, PSEvt::Event& evt);
+
+  /// Make copies of module chain and start threads
+  void startThreads();
+
+  /**
+   *  Read more events following the given one and process them in parallel,
+   *  processed events are added to m_values.
+   */
+  void processBatch(const EventPtr& first);
+
+  /**
+   *  Read more events following the given one and pass them to modules as
+   *  a batch, processed events are added to m_values.
+   */
+  void callBatch(const EventPtr& first);
+
+  /**
+   *  Read up to maxSize consecutive regular events starting with the given
+   *  one, first transition that follows them is saved in m_pending.
+   */
+  void readBatch(const EventPtr& first, unsigned maxSize, std::vector<EventPtr>& events);
+
+  /// Print/save profiling results
+  void printProfile() const;
+
+  /// Print event pool statistics
+  void printPoolStats() const;
+
+  /// Print and reset time budget overruns
+  void printOverruns();
+
+  /// Save input position and module state to checkpoint file
+  void writeCheckpoint();
+
+  /// Restore module state and input position from checkpoint file
+  void resume();
+
+  /// Module with the key of its state in checkpoint
+  typedef std::pair<std::string, boost::shared_ptr<Module> > NamedModule;
+
+  /// Returns all modules whose state is saved in checkpoint
+  std::vector<NamedModule> checkpointModules() const;
+
+  /**
+   *  Pass event or transition to additional chains, for regular events skip
+   *  flag is restored from the skipped argument after all chains are called.
+   *  Returns Abort if any chain requested abort, OK otherwise.
+   */
+  Module::Status callChains(EventType evtType, PSEvt::Event& evt, bool skipped);
+
+  /// Stop passing events to regular modules, finish input if no other chain needs events
+  void stopMain();
+
+  /// Returns true if all additional chains requested stop
+  bool allChainsStopped() const;
+
+  // Additional chain of modules with its own stop state
+  struct NamedChain {
+    std::string name;
+    boost::shared_ptr<ModuleChain> chain;
+    bool stopped;
+  };
 
 
   boost::shared_ptr<InputIter> m_inputIter;
-  std::vector<boost::shared_ptr<Module> > m_modules;
-  ModuleMethod m_eventMethods[NumEventTypes];
-  std::deque<value_type> m_values;
+  boost::shared_ptr<ModuleChain> m_earlyChain;            ///< Early filter modules, may be zero
+  boost::shared_ptr<ModuleChain> m_chain;                 ///< Modules called for every event
+  std::vector<boost::shared_ptr<ModuleChain> > m_copies;  ///< Copies of m_chain for other threads
+  std::deque<value_type> m_values;                        ///< Processed events
+  std::deque<value_type> m_pending;                       ///< Unprocessed events read from input
+  boost::shared_ptr<ModuleProfiler> m_profiler;  ///< Non-zero if profiling is enabled
+  std::string m_profileFile;
+  unsigned m_nThreads;
+  boost::shared_ptr<ThreadPool> m_threadPool;   ///< Non-zero in multi-threaded mode
+  unsigned m_moduleThreads;
+  unsigned m_beginThreads;
+  unsigned m_batchSize;
+  unsigned long m_nEarlyRejected;   ///< Number of events rejected by early filters
+  bool m_timeBudget;                ///< True if time budgets are set
+  unsigned m_readAheadDepth;
+  unsigned m_liveMaxLag;            ///< Maximum lag in live mode, 0 for no limit
+  unsigned long m_liveDropped;      ///< Number of events dropped in current run
+  std::vector<NamedChain> m_chains; ///< Additional chains, called after regular modules
+  bool m_mainStopped;               ///< True if regular modules requested stop
+  std::string m_checkpointFile;     ///< Checkpoint file name, empty if disabled
+  unsigned m_checkpointInterval;    ///< Number of calib cycles between checkpoints
+  unsigned long m_nCalibCycles;     ///< Number of calib cycles since last checkpoint
+  std::string m_resumeFile;         ///< Checkpoint to resume from, empty if not resuming
+  bool m_skipEventKey;              ///< True if skipped events returned from next() get special key
+  bool m_timeWindow;                ///< True if only events in [m_tmin, m_tmax) are read
+  EventTime m_tmin;
+  EventTime m_tmax;
 
   // for indexing only
   const boost::shared_ptr<InputModule> m_inputModule;
@@ -0,0 +1,125 @@
+#ifndef PSANA_EVENTPOOL_H
+#define PSANA_EVENTPOOL_H
+
+//--------------------------------------------------------------------------
+// File and Version Information:
+//     $Id$
+//
+// Description:
+//     Class EventPool.
+//
+//------------------------------------------------------------------------
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+#include <iosfwd>
+#include <vector>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/utility.hpp>
+
+//----------------------
+// Base Class Headers --
+//----------------------
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+#include "PSEvt/AliasMap.h"
+#include "PSEvt/Event.h"
+
+//------------------------------------
+// Collaborating Class Declarations --
+//------------------------------------
+
+//             ---------------------
+//             -- Class Interface --
+//             ---------------------
+
+namespace psana {
+
+/// @addtogroup psana
+
+/**
+ *  @ingroup psana
+ *
+ *  @brief Pool of event objects which are reused after they are released.
+ *
+ *  Event objects returned from get() have special deleter; when the last
+ *  reference to event disappears all data are removed from its dictionary
+ *  and event is kept in the pool (up to maximum pool size) to be returned
+ *  from next get() call. Events can be released in any thread. Pool must
+ *  be created with boost::make_shared, events can outlive the pool.
+ *
+ *  This software was developed for the LCLS project.  If you use all or
+ *  part of it, please give an appropriate acknowledgment.
+ *
+ *  @version $Id$
+ *
+ *  @author Andy Salnikov
+ */
+
+class EventPool : boost::noncopyable, public boost::enable_shared_from_this<EventPool> {
+public:
+
+  typedef boost::shared_ptr<PSEvt::Event> EventPtr;
+
+  /**
+   *  @brief Constructor takes alias map for new events and maximum number
+   *  of released events kept in the pool, zero disables pooling.
+   */
+  EventPool(const boost::shared_ptr<PSEvt::AliasMap>& aliasMap, unsigned maxSize);
+
+  // Destructor
+  ~EventPool();
+
+  /// Change maximum number of released events kept in the pool
+  void setMaxSize(unsigned maxSize);
+
+  /// Returns maximum number of released events kept in the pool
+  unsigned maxSize() const;
+
+  /// Returns new empty event, it is taken from the pool if possible
+  EventPtr get();
+
+  /// Print pool statistics
+  void print(std::ostream& out) const;
+
+  /// Returns number of events created by this pool
+  unsigned long nCreated() const;
+
+  /// Returns number of events which were taken from the pool
+  unsigned long nReused() const;
+
+  /// Returns number of released events currently in the pool
+  unsigned size() const;
+
+protected:
+
+private:
+
+  // deleter for events created by pool
+  struct Recycler {
+    Recycler(const boost::weak_ptr<EventPool>& pool) : pool(pool) {}
+    void operator()(PSEvt::Event* evt) const;
+    boost::weak_ptr<EventPool> pool;
+  };
+
+  // clear event and return it to the pool or delete it
+  void recycle(PSEvt::Event* evt);
+
+  boost::shared_ptr<PSEvt::AliasMap> m_aliasMap;
+  unsigned m_maxSize;
+  std::vector<PSEvt::Event*> m_free;  ///< released events
+  unsigned long m_nCreated;
+  unsigned long m_nReused;
+  unsigned long m_nDeleted;           ///< released events which did not fit in the pool
+  unsigned m_maxFree;                 ///< maximum size of m_free
+  mutable boost::mutex m_mutex;
+};
+
+} // namespace psana
+
+#endif // PSANA_EVENTPOOL_H
@@ -0,0 +1,145 @@
+#ifndef PSANA_EVENTTIMEARRAY_H
+#define PSANA_EVENTTIMEARRAY_H
+
+//--------------------------------------------------------------------------
+// File and Version Information:
+//     $Id$
+//
+// Description:
+//     Class EventTimeArray.
+//
+//------------------------------------------------------------------------
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include <boost/cstdint.hpp>
+
+//----------------------
+// Base Class Headers --
+//----------------------
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+#include "psana/EventTime.h"
+
+//------------------------------------
+// Collaborating Class Declarations --
+//------------------------------------
+
+//             ---------------------
+//             -- Class Interface --
+//             ---------------------
+
+namespace psana {
+
+/// @addtogroup psana
+
+/**
+ *  @ingroup psana
+ *
+ *  @brief Columnar container of event times.
+ *
+ *  Seconds, nanoseconds and fiducials are kept in separate arrays so that
+ *  searches can compare several times at once with SIMD instructions (SSE2
+ *  when available, scalar code otherwise). Times must be added in
+ *  increasing order of time (seconds, then nanoseconds), which is the
+ *  order returned by Index::times().
+ *
+ *  Two times of different data streams belong to the same event if their
+ *  fiducials are equal and their times differ by less than a tolerance,
+ *  match() finds such pairs for all events of two arrays.
+ *
+ *  This software was developed for the LCLS project.  If you use all or
+ *  part of it, please give an appropriate acknowledgment.
+ *
+ *  @version $Id$
+ *
+ *  @author Andy Salnikov
+ */
+
+class EventTimeArray {
+public:
+
+  /// Value returned by searches when nothing is found
+  static const size_t npos = size_t(-1);
+
+  // Default constructor
+  EventTimeArray() : m_sec(), m_nsec(), m_fid() {}
+
+  /// Make array from a range of EventTime objects, e.g. from Index::times()
+  template <typename Iter>
+  EventTimeArray(Iter begin, Iter end) : m_sec(), m_nsec(), m_fid() {
+    for ( ; begin != end; ++ begin) push_back(*begin);
+  }
+
+  /// Add one time at the end, times must be added in increasing order
+  void push_back(const EventTime& time) {
+    m_sec.push_back(time.seconds());
+    m_nsec.push_back(time.nanoseconds());
+    m_fid.push_back(time.fiducial());
+  }
+
+  /// Returns number of times
+  size_t size() const { return m_sec.size(); }
+
+  /// Returns time with given index
+  EventTime operator[](size_t i) const {
+    return EventTime((uint64_t(m_sec[i]) << 32) | m_nsec[i], m_fid[i]);
+  }
+
+  /// Column of seconds
+  const std::vector<uint32_t>& seconds() const { return m_sec; }
+
+  /// Column of nanoseconds
+  const std::vector<uint32_t>& nanoseconds() const { return m_nsec; }
+
+  /// Column of fiducials
+  const std::vector<uint32_t>& fiducials() const { return m_fid; }
+
+  /// Returns index of the first time which is not less than given, fiducial is ignored
+  size_t lowerBound(const EventTime& time) const;
+
+  /// Returns index of time which has the same time and fiducial, npos if not found
+  size_t find(const EventTime& time) const;
+
+  /**
+   *  @brief Find time closest to given one with the same fiducial.
+   *
+   *  @param[in] time       Time to look for
+   *  @param[in] tolerance  Maximum difference of times in nanoseconds
+   *  @return Index of found time or npos
+   */
+  size_t findNearest(const EventTime& time, uint64_t tolerance) const;
+
+  /**
+   *  @brief Match times of this array with times of another array.
+   *
+   *  For every time in this array the nearest time in the other array with
+   *  the same fiducial and within tolerance is found, pairs of indices
+   *  (this, other) are appended to matches.
+   *
+   *  @return Number of matched pairs
+   */
+  size_t match(const EventTimeArray& other, uint64_t tolerance,
+      std::vector<std::pair<size_t, size_t> >& matches) const;
+
+protected:
+
+private:
+
+  // Returns index of first time not less than given time in [begin, end)
+  size_t lowerBound(uint32_t sec, uint32_t nsec, size_t begin, size_t end) const;
+
+  std::vector<uint32_t> m_sec;
+  std::vector<uint32_t> m_nsec;
+  std::vector<uint32_t> m_fid;
+};
+
+} // namespace psana
+
+#endif // PSANA_EVENTTIMEARRAY_H
@@ -32,6 +32,17 @@ public:
   virtual void     times(EventTimeIter& begin, EventTimeIter& end) = 0;
   virtual void     times(unsigned step, EventTimeIter& begin, EventTimeIter& end) = 0;
   virtual const    std::vector<unsigned>& runs()                = 0;
+
+  /**
+   *  @brief Restrict reading of current run to time window [t0, t1).
+   *
+   *  Implementation resolves the window to contiguous ranges of offsets in
+   *  every file (see TimeIndex::select()) and reads them sequentially, so
+   *  that the cost is proportional to the window rather than to the run.
+   *  Returns 0 on success. Default implementation does not support windows
+   *  and returns -1.
+   */
+  virtual int      select(EventTime t0, EventTime t1)          { return -1; }
 };
 
 }
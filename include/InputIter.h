@@ -26,6 +26,8 @@
 //-------------------------------
 // Collaborating Class Headers --
 //-------------------------------
+#include "psana/EventPool.h"
+#include "psana/InputModule.h"
 #include "PSEvt/AliasMap.h"
 #include "PSEnv/Env.h"
 #include "PSEvt/Event.h"
@@ -34,7 +36,7 @@
 // Collaborating Class Declarations --
 //------------------------------------
 namespace psana {
-class InputModule;
+class InputReadAhead;
 }
 
 //		---------------------
@@ -115,15 +117,93 @@ public:
    */
   void finish();
 
+  /**
+   *  @brief Enable reading of input data in a separate thread.
+   *
+   *  When depth is positive the input module is called from a background
+   *  thread which keeps up to depth events read ahead of the events returned
+   *  from next(). Zero depth (default) means that input module is called
+   *  synchronously from next(). Read-ahead is not enabled if input module
+   *  updates environment (see InputModule::updatesEnv()). Must be called
+   *  before first call to next().
+   */
+  void setReadAhead(unsigned depth);
+
+  /// Returns read-ahead depth, zero if input is read synchronously
+  unsigned readAheadDepth() const { return m_readAheadDepth; }
+
+  /**
+   *  @brief Set maximum number of released events kept for reuse.
+   *
+   *  Event objects are created by EventPool, when event is released by all
+   *  users its contents is cleared and it is reused for one of the following
+   *  events. Zero size (default) disables reuse.
+   */
+  void setEventPoolSize(unsigned size) { m_eventPool->setMaxSize(size); }
+
+  /**
+   *  @brief Read events in two steps.
+   *
+   *  When enabled input module eventHeader() is called instead of event(),
+   *  caller must then call readPayload() for every accepted regular event
+   *  before the next call to next(); transitions are completed by iterator
+   *  itself. Read-ahead thread always reads complete
+   *  events. Must be called before first call to next().
+   */
+  void setTwoPhase(bool twoPhase) { m_twoPhase = twoPhase; }
+
+  /**
+   *  @brief Read remaining data for the regular event returned from next().
+   *
+   *  Does nothing unless two-phase reading is enabled.
+   */
+  void readPayload(PSEvt::Event& evt);
+
+  /**
+   *  @brief Keep several reads in flight for asynchronous input modules.
+   *
+   *  If input module is an AsyncInputModule then before every read up to
+   *  depth reads are kept submitted. Zero (default) means that reads are
+   *  submitted one at a time. Not used when read-ahead is enabled.
+   */
+  void setAsyncDepth(unsigned depth) { m_asyncDepth = depth; }
+
+  /// Returns number of reads kept in flight, see setAsyncDepth()
+  unsigned asyncDepth() const { return m_asyncDepth; }
+
+  /**
+   *  @brief Skip regular events up to the next transition.
+   *
+   *  Regular events which are already read are discarded, the input module
+   *  is asked to skip remaining events (see InputModule::skipToTransition()),
+   *  if it cannot do it then next() discards regular events which it reads.
+   *  Transitions are returned from next() as usual. Nothing is skipped if a
+   *  transition is already queued. Regular event which implicitly starts a
+   *  calib cycle (input without BeginCalibCycle) ends skipping, it is
+   *  returned after the BeginCalibCycle.
+   */
+  void skipEvents();
+
+  /// Returns pool of event objects
+  const EventPool& eventPool() const { return *m_eventPool; }
+
 protected:
 
 private:
 
+  /// Get next event and its status from input module or read-ahead queue
+  InputModule::Status readInput(EventPtr& evt);
+
+  /// Stop read-ahead thread if it is running
+  void stopReadAhead();
+
   void newState(State state, const EventPtr& evt);
   void closeState(const EventPtr& evt);
   void unwind(State newState, const EventPtr& evt);
 
   boost::shared_ptr<InputModule> m_inputModule;
+  AsyncInputModule* m_asyncModule;   ///< Same as m_inputModule if it is asynchronous, zero otherwise
+  unsigned m_asyncDepth;
   boost::shared_ptr<PSEnv::Env> m_env;
   bool m_finished;
   State m_state;
@@ -131,6 +211,11 @@ private:
   EventType m_closeStateEventType[NumStates];
   std::deque<value_type> m_values;
   boost::shared_ptr<PSEvt::AliasMap> m_aliasMap;
+  boost::shared_ptr<EventPool> m_eventPool;
+  unsigned m_readAheadDepth;
+  bool m_twoPhase;
+  bool m_skipping;      ///< True if regular events are discarded until next transition
+  boost::shared_ptr<InputReadAhead> m_readAhead;
 };
 
 /// formatting for InputIter::EventType enum
@@ -14,6 +14,7 @@
 // C/C++ Headers --
 //-----------------
 #include <string>
+#include <vector>
 #include <iosfwd>
 #include <boost/utility.hpp>
 
@@ -131,6 +132,87 @@ public:
    *  @param[out] env    Environment object
    */
   virtual Status event(Event& evt, Env& env) = 0;
+
+  /**
+   *  @brief Method which reads light part of the next event.
+   *
+   *  Called instead of event() when early filter modules are configured
+   *  (psana.early-filters option). Input module which can read event data
+   *  in two steps should add only cheap data (e.g. EVR or BLD data) to the
+   *  event here and return the same status as event() would. If the status
+   *  is DoEvent and event is accepted by early filters then eventPayload()
+   *  is called for the same event before the next call to eventHeader(),
+   *  rejected events do not get eventPayload() call. For transitions
+   *  (BeginRun, BeginCalibCycle, EndCalibCycle, EndRun) eventPayload() is
+   *  always called right after eventHeader(), so the two methods together
+   *  must read the same data as event(). This method is also used for
+   *  skipping events (see skipToTransition()), in that case eventPayload()
+   *  is only called for transitions.
+   *
+   *  Default implementation calls event().
+   *
+   *  @param[out] evt    Event object
+   *  @param[out] env    Environment object
+   */
+  virtual Status eventHeader(Event& evt, Env& env);
+
+  /**
+   *  @brief Method which reads remaining data for an accepted event.
+   *
+   *  Called after eventHeader() for every transition and for regular events
+   *  accepted by early filters, see eventHeader(). Default implementation
+   *  does nothing.
+   *
+   *  @param[in,out] evt Event object
+   *  @param[out] env    Environment object
+   */
+  virtual void eventPayload(Event& evt, Env& env);
+
+  /**
+   *  @brief Skip regular events up to the next transition.
+   *
+   *  Called when framework does not need regular events until the next
+   *  transition, e.g. when user iterates over steps or runs. Input module
+   *  which can find next transition cheaply (from index or by reading only
+   *  datagram headers) should position itself so that next call to event()
+   *  returns status other than DoEvent and return true. If it returns false
+   *  then framework reads remaining events with eventHeader() and discards
+   *  them. Default implementation returns false.
+   *
+   *  @param[out] env    Environment object
+   *  @return true if events were skipped
+   */
+  virtual bool skipToTransition(Env& env);
+
+  /**
+   *  @brief Returns true if event() may update environment.
+   *
+   *  Framework features which read events ahead of the event being
+   *  processed (read-ahead thread, batches of events) cannot be used when
+   *  input module updates configuration or EPICS stores for regular events,
+   *  as modules would see the environment of a different event. Input
+   *  module which never touches environment in event() should override
+   *  this method and return false. Default implementation returns true.
+   */
+  virtual bool updatesEnv() const;
+
+  /**
+   *  @brief Returns current input position for restarting the job.
+   *
+   *  Called right after EndCalibCycle when checkpointing is enabled. Input
+   *  module which supports RandomAccess should fill the arguments with the
+   *  values which, passed to RandomAccess::setrun() and RandomAccess::jump(),
+   *  make it continue with the data following that EndCalibCycle. Default
+   *  implementation returns false which means position is not known.
+   *
+   *  @param[out] run       Run number
+   *  @param[out] filenames Names of the files being read
+   *  @param[out] offsets   Offset of the next datagram in every file
+   *  @param[out] lastBeginCalibCycleDgram  Last BeginCalibCycle datagram
+   *  @return true if position is known
+   */
+  virtual bool resumePosition(int& run, std::vector<std::string>& filenames,
+      std::vector<int64_t>& offsets, std::string& lastBeginCalibCycleDgram);
   
   virtual Index& index();
 
@@ -159,6 +241,69 @@ private:
 
 };
 
+/**
+ *  @ingroup psana
+ *
+ *  @brief Base class for input modules which can have several reads in flight.
+ *
+ *  Reading is split in two steps: doSubmit() starts reading of the next few
+ *  events (e.g. with asynchronous I/O or in a pool of threads) and returns
+ *  immediately, doComplete() waits for the oldest submitted read and fills
+ *  event and environment, returning the same status as event() would.
+ *  Reads are completed in the order in which they were submitted. Framework
+ *  keeps up to psana.async-depth reads outstanding (see
+ *  InputIter::setAsyncDepth()). Subclass should cancel outstanding reads in
+ *  endJob().
+ *
+ *  This software was developed for the LCLS project.  If you use all or
+ *  part of it, please give an appropriate acknowledgment.
+ *
+ *  @version $Id$
+ *
+ *  @author Andy Salnikov
+ */
+
+class AsyncInputModule : public InputModule {
+public:
+
+  // Destructor
+  virtual ~AsyncInputModule();
+
+  /**
+   *  @brief Submit reads of up to nEvents following events.
+   *
+   *  @return Number of reads actually submitted, may be less than requested,
+   *          e.g. at the end of data.
+   */
+  unsigned submit(unsigned nEvents);
+
+  /// Returns number of submitted reads which are not completed yet
+  unsigned outstanding() const { return m_outstanding; }
+
+  /**
+   *  @brief Completes oldest outstanding read.
+   *
+   *  If there are no outstanding reads one read is submitted first, if
+   *  nothing can be submitted Stop is returned.
+   */
+  virtual Status event(Event& evt, Env& env);
+
+protected:
+
+  /// Constructor may be called from subclass only.
+  AsyncInputModule(const std::string& name);
+
+  /// Start reading up to nEvents following events, returns number of submitted reads
+  virtual unsigned doSubmit(unsigned nEvents) = 0;
+
+  /// Wait for the oldest submitted read to finish and fill event, see event()
+  virtual Status doComplete(Event& evt, Env& env) = 0;
+
+private:
+
+  unsigned m_outstanding;  ///< Number of submitted but not completed reads
+};
+
 /// formatting for InputModule::Status enum
 std::ostream&
 operator<<(std::ostream& out, InputModule::Status stat);
@@ -0,0 +1,139 @@
+#ifndef PSANA_INPUTREADAHEAD_H
+#define PSANA_INPUTREADAHEAD_H
+
+//--------------------------------------------------------------------------
+// File and Version Information:
+//     $Id$
+//
+// Description:
+//     Class InputReadAhead.
+//
+//------------------------------------------------------------------------
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+#include <deque>
+#include <string>
+#include <utility>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/utility.hpp>
+
+//----------------------
+// Base Class Headers --
+//----------------------
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+#include "psana/EventPool.h"
+#include "psana/InputModule.h"
+#include "PSEnv/Env.h"
+#include "PSEvt/Event.h"
+
+//------------------------------------
+// Collaborating Class Declarations --
+//------------------------------------
+
+//             ---------------------
+//             -- Class Interface --
+//             ---------------------
+
+namespace psana {
+
+/// @addtogroup psana
+
+/**
+ *  @ingroup psana
+ *
+ *  @brief Background reader for input module.
+ *
+ *  Instance of this class runs a separate thread which calls input module
+ *  event() method and keeps up to N populated events together with the
+ *  status returned from input module in a bounded queue. InputIter
+ *  takes events from this queue instead of calling input module directly,
+ *  so that reading and decoding of the next events overlaps with the
+ *  processing of the current event by user modules.
+ *
+ *  Environment object is shared with the modules which run in the main
+ *  thread, so only input modules which do not update environment in
+ *  event() can be used (see InputModule::updatesEnv()), InputIter checks
+ *  this before creating the reader.
+ *
+ *  This software was developed for the LCLS project.  If you use all or
+ *  part of it, please give an appropriate acknowledgment.
+ *
+ *  @version $Id$
+ *
+ *  @author Andy Salnikov
+ */
+
+class InputReadAhead : boost::noncopyable {
+public:
+
+  typedef boost::shared_ptr<PSEvt::Event> EventPtr;
+  typedef std::pair<InputModule::Status, EventPtr> value_type;
+
+  /**
+   *  @brief Constructor starts reading thread.
+   *
+   *  @param[in] inputModule  Input module instance, after beginJob() was called
+   *  @param[in] env          Environment object
+   *  @param[in] eventPool    Pool which provides new event objects
+   *  @param[in] depth        Maximum number of events kept in the queue, must be positive
+   */
+  InputReadAhead(const boost::shared_ptr<InputModule>& inputModule,
+                 const boost::shared_ptr<PSEnv::Env>& env,
+                 const boost::shared_ptr<EventPool>& eventPool,
+                 unsigned depth);
+
+  // Destructor stops reading thread
+  ~InputReadAhead();
+
+  /**
+   *  @brief Returns next status and event from the queue, waits if queue is empty.
+   *
+   *  After input module returns Stop or Abort no more events are read, all
+   *  following calls return Stop status. If input module throws an exception
+   *  of any type then Abort is returned and error() returns exception message.
+   */
+  value_type next();
+
+  /**
+   *  @brief Stop reading thread and discard all events in the queue.
+   *
+   *  Waits until input module returns from current event() call, after
+   *  this method returns input module can be safely used by the caller.
+   */
+  void stop();
+
+  /// Returns error message if reading thread was terminated by exception
+  const std::string& error() const { return m_error; }
+
+protected:
+
+private:
+
+  // body of the reading thread
+  void run();
+
+  boost::shared_ptr<InputModule> m_inputModule;
+  boost::shared_ptr<PSEnv::Env> m_env;
+  boost::shared_ptr<EventPool> m_eventPool;
+  const unsigned m_depth;
+  std::deque<value_type> m_queue;   ///< events read but not yet consumed
+  bool m_stop;                      ///< set to true to tell thread to stop
+  bool m_done;                      ///< set to true by the thread when it finishes
+  std::string m_error;
+  boost::mutex m_mutex;
+  boost::condition_variable m_notFull;
+  boost::condition_variable m_notEmpty;
+  boost::thread m_thread;           ///< must be last, thread is started in constructor
+};
+
+} // namespace psana
+
+#endif // PSANA_INPUTREADAHEAD_H
@@ -13,7 +13,10 @@
 //-----------------
 // C/C++ Headers --
 //-----------------
+#include <iosfwd>
 #include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
 #include <boost/utility.hpp>
 
 //----------------------
@@ -24,6 +27,7 @@
 //-------------------------------
 // Collaborating Class Headers --
 //-------------------------------
+#include "psana/EventBatch.h"
 #include "PSEnv/Env.h"
 #include "PSEvt/Event.h"
 
@@ -144,6 +148,27 @@ public:
    *  @param[in] env  Environment object. 
    */
   virtual void event(Event& evt, Env& env) = 0;
+
+  /**
+   *  @brief Method which is called with a batch of events in batch mode
+   *
+   *  In batch mode (psana.batch-size option) framework collects several
+   *  consecutive events from the same calib cycle and calls this method
+   *  once for the whole batch. Modules which can process several events
+   *  at once should override this method. To skip individual events call
+   *  batch.skip(i), calling skip() skips all events in a batch. Calling
+   *  stop() finishes the job after current batch is processed.
+   *
+   *  Default implementation calls event() for every event in a batch
+   *  which is not skipped yet (or for every event if module observes all
+   *  events) and translates status of each call into batch status.
+   *  All events of a batch are read before this method is called, so
+   *  environment may reflect the state of the last event in a batch.
+   *
+   *  @param[in,out] batch  Batch of events
+   *  @param[in] env  Environment object.
+   */
+  virtual void eventBatch(EventBatch& batch, Env& env);
   
   /**
    *  @brief Method which is called at the end of the calibration cycle (step)
@@ -172,15 +197,113 @@ public:
    */
   virtual void endJob(Event& evt, Env& env);
 
-  /// reset module status
-  void reset() { m_status = OK; }
+  /**
+   *  @brief Reset module status before the call.
+   *
+   *  Framework also passes the flag which is true if current event was
+   *  skipped by one of the preceding modules.
+   */
+  void reset(bool eventSkipped = false) { m_status = OK; m_eventSkipped = eventSkipped; }
   
   /// get status
   Status status() const { return m_status; }
 
   /// Returns true if this module is interested in all events including skipped
   bool observeAllEvents() const { return m_observeAllEvents; }
-  
+
+  /**
+   *  @brief Returns true if current event was skipped by one of the preceding modules.
+   *
+   *  Only modules which observe all events can see skipped events. This is
+   *  faster replacement for checking "__psana_skip_event__" key in the event,
+   *  for compatibility the key is still added to skipped events before they
+   *  are passed to modules which observe all events.
+   */
+  bool eventSkipped() const { return m_eventSkipped; }
+
+  /**
+   *  @brief Make a copy of this module for multi-threaded event processing.
+   *
+   *  In multi-threaded mode (psana.threads option) each thread runs its
+   *  own copy of the module chain. Modules which support this mode should
+   *  override this method and return new instance with the same name, e.g.
+   *  "return new MyModule(name());", so that it reads the same configuration.
+   *  Framework takes ownership of the returned object. Copies receive all
+   *  transitions in the same order as original module, but each regular
+   *  event is seen by only one of the copies. Transition events and
+   *  environment are shared between copies, so only one copy should add
+   *  data to them. Environment is not protected against concurrent access,
+   *  copies must not use it in event(); data like calibrations should be
+   *  retrieved in beginRun() or beginCalibCycle() which are called for one
+   *  copy at a time.
+   *
+   *  Default implementation returns zero pointer which means that the module
+   *  cannot be copied, in this case multi-threaded mode is disabled.
+   */
+  virtual Module* clone() const;
+
+  /// Returns true if module declared any data which it consumes or produces
+  bool declaresDependencies() const { return not m_consumes.empty() or not m_produces.empty(); }
+
+  /// Returns list of data keys declared with consumes()
+  const std::vector<std::string>& consumedKeys() const { return m_consumes; }
+
+  /// Returns list of data keys declared with produces()
+  const std::vector<std::string>& producedKeys() const { return m_produces; }
+
+  /// Returns true if products of this module can be stored in product cache
+  bool cacheable() const { return m_cacheable; }
+
+  /// Returns true if module declared that it may call skip() or stop()
+  bool mayFilter() const { return m_mayFilter; }
+
+  /**
+   *  @brief Save data which event() added to the event.
+   *
+   *  Only called for cacheable modules (see setCacheable()) when product
+   *  cache is enabled (psana.product-cache option), after event() finished
+   *  with OK or Skip status. Module writes all data that it added to the
+   *  event in any format understood by loadProducts(). Default
+   *  implementation writes nothing, which is enough for pure filters.
+   */
+  virtual void saveProducts(Event& evt, std::ostream& out) const;
+
+  /**
+   *  @brief Restore data saved by saveProducts().
+   *
+   *  Called instead of event() when products for this event are found in
+   *  the cache. Module should add the same data to the event as event()
+   *  did. Status of the module is restored by framework.
+   */
+  virtual void loadProducts(Event& evt, std::istream& in);
+
+  /**
+   *  @brief Returns hash of module configuration.
+   *
+   *  Hash includes all parameters from the module and class sections of
+   *  configuration, it is used to invalidate cached products when
+   *  configuration changes.
+   */
+  uint64_t configHash() const;
+
+  /**
+   *  @brief Save module state for a checkpoint.
+   *
+   *  Called after EndCalibCycle when checkpointing is enabled (psana.checkpoint
+   *  option). Module writes whatever it needs to continue after restart,
+   *  e.g. accumulated sums or histogram contents, in any format understood
+   *  by loadCheckpoint(). Default implementation writes nothing.
+   */
+  virtual void saveCheckpoint(std::ostream& out) const;
+
+  /**
+   *  @brief Restore module state saved by saveCheckpoint().
+   *
+   *  Called once after beginJob() when job resumes from a checkpoint,
+   *  before any events from the resumed position are processed.
+   */
+  virtual void loadCheckpoint(std::istream& in);
+
 protected:
 
   /// The one and only constructor, needs module name.
@@ -211,10 +334,72 @@ protected:
    */
   void terminate() { m_status = Abort; }
 
+  /**
+   *  @brief Declare event data read by this module.
+   *
+   *  Key is any string which identifies the data, e.g. source address or
+   *  key name, producer and consumer of the same data must use the same
+   *  string. Declarations are used to run independent modules concurrently
+   *  (psana.module-threads option), they have to be made in constructor or
+   *  in beginJob(). Module which declares its data must be able to run in
+   *  parallel with other such modules; if it may call skip() or stop() it
+   *  has to say so with setMayFilter(). If other module calls skip()
+   *  or stop() while the following modules run in parallel with it, the job
+   *  is aborted. Modules which do not declare anything, and filters, are
+   *  always executed after all preceding modules are finished and before
+   *  any following module is started.
+   */
+  void consumes(const std::string& key) { m_consumes.push_back(key); }
+
+  /**
+   *  @brief Declare event data added to event by this module.
+   *
+   *  See consumes() for details. Modules which produce data, as well as
+   *  modules whose products are restored from product cache, are never run
+   *  concurrently with other modules because event store is not protected
+   *  against concurrent updates. Modules running in parallel must only
+   *  read event data; framework aborts the job if it notices that event
+   *  grew during a parallel step, but this check happens after the fact
+   *  and is a debugging aid, not a protection against data races.
+   */
+  void produces(const std::string& key) { m_produces.push_back(key); }
+
+  /**
+   *  @brief Declare that module may call skip() or stop() in event().
+   *
+   *  Only matters for modules which declare their data (see consumes()).
+   *  Such module is called alone, after all preceding modules are finished
+   *  and before any following module is started, so that its decision is
+   *  applied as in sequential mode. Has to be called in constructor or in
+   *  beginJob().
+   */
+  void setMayFilter(bool mayFilter = true) { m_mayFilter = mayFilter; }
+
+  /**
+   *  @brief Allow framework to cache products of this module.
+   *
+   *  When product cache is enabled, data which module adds to event are
+   *  saved on disk with saveProducts(), keyed by event time, module name
+   *  and configuration hash. When the same events are processed again
+   *  event() is not called, instead data are restored with loadProducts().
+   *  Module must not depend on anything but the event and configuration,
+   *  any internal state updated in event() will not be updated for cached
+   *  events. Has to be called in constructor.
+   */
+  void setCacheable(bool cacheable = true) { m_cacheable = cacheable; }
+
 private:
 
+  // chain restores status of the module for cached events
+  friend class ModuleChain;
+
   Status m_status;  ///< Current event processing status
   bool m_observeAllEvents; ///< If true then this module will receive all events, event skipped ones
+  bool m_eventSkipped;  ///< True if current event was skipped by preceding module
+  std::vector<std::string> m_consumes;  ///< Keys of data read by this module
+  std::vector<std::string> m_produces;  ///< Keys of data produced by this module
+  bool m_cacheable;  ///< True if products can be cached
+  bool m_mayFilter;  ///< True if module may call skip() or stop()
 
 };
 
@@ -0,0 +1,273 @@
+#ifndef PSANA_MODULECHAIN_H
+#define PSANA_MODULECHAIN_H
+
+//--------------------------------------------------------------------------
+// File and Version Information:
+//     $Id$
+//
+// Description:
+//     Class ModuleChain.
+//
+//------------------------------------------------------------------------
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+
+//----------------------
+// Base Class Headers --
+//----------------------
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+#include "psana/EventBatch.h"
+#include "psana/EventLoop.h"
+#include "psana/Module.h"
+#include "PSEnv/Env.h"
+#include "PSEvt/Event.h"
+
+//------------------------------------
+// Collaborating Class Declarations --
+//------------------------------------
+namespace psana {
+class ModuleProfiler;
+class ProductCache;
+class ThreadPool;
+}
+
+//             ---------------------
+//             -- Class Interface --
+//             ---------------------
+
+namespace psana {
+
+/// @addtogroup psana
+
+/**
+ *  @ingroup psana
+ *
+ *  @brief Ordered list of user modules.
+ *
+ *  This class calls user module methods for every transition or event
+ *  in the order in which modules were added and combines statuses returned
+ *  by individual modules. For regular events it respects Skip status: modules
+ *  following the module which requested skip are only called if they want
+ *  to observe all events. Skip state is kept in the status returned from
+ *  call() and in Module::eventSkipped(), the "__psana_skip_event__" key is
+ *  only added to the event before it is passed to a module which observes
+ *  all events, for compatibility with modules which look for it.
+ *
+ *  For transitions chain only calls modules which override corresponding
+ *  method (this check is only available when compiled with GCC, otherwise
+ *  all modules are called).
+ *
+ *  Chain can make a copy of itself for use in a different thread, every
+ *  module in the copy is made with Module::clone().
+ *
+ *  If thread pool is given to the chain then modules which declare their
+ *  data dependencies (see Module::consumes()) can be called concurrently
+ *  for regular events. After beginJob() the chain builds a schedule, which
+ *  is a sequence of steps, modules in one step are independent of each
+ *  other and run in parallel. Module without declarations, module which
+ *  produces data or module whose products are cached always makes a
+ *  separate step; modules which may filter events (Module::mayFilter())
+ *  in addition run after all preceding and before all following modules.
+ *  If a module in parallel step requests skip or stop which would prevent
+ *  following modules in the same step from running, ExceptionAbort is
+ *  thrown. The same happens if a module in parallel step adds data to the
+ *  event, but this is only detected after the step finished.
+ *
+ *  This software was developed for the LCLS project.  If you use all or
+ *  part of it, please give an appropriate acknowledgment.
+ *
+ *  @version $Id$
+ *
+ *  @author Andy Salnikov
+ */
+
+class ModuleChain : boost::noncopyable {
+public:
+
+  /// Constructor takes the list of modules
+  explicit ModuleChain(const std::vector<boost::shared_ptr<Module> >& modules);
+
+  // Destructor
+  ~ModuleChain();
+
+  /// Add one more module at the end of the chain
+  void add(const boost::shared_ptr<Module>& module);
+
+  /// Returns list of modules
+  const std::vector<boost::shared_ptr<Module> >& modules() const { return m_modules; }
+
+  /// Set profiler instance, zero pointer disables profiling
+  void setProfiler(const boost::shared_ptr<ModuleProfiler>& profiler) { m_profiler = profiler; }
+
+  /**
+   *  @brief Set thread pool used to run independent modules concurrently.
+   *
+   *  Must be called before BeginJob, schedule is built after all modules
+   *  finished their beginJob() method. Zero pointer disables concurrency.
+   */
+  void setThreadPool(const boost::shared_ptr<ThreadPool>& threadPool);
+
+  /**
+   *  @brief Set thread pool used to run begin transitions concurrently.
+   *
+   *  Modules which declare their data dependencies have their beginRun()
+   *  and beginCalibCycle() methods called in parallel unless one depends on
+   *  another. Modules which declare products (including cacheable modules)
+   *  are called one at a time as they may add data to the transition event
+   *  or environment stores; ExceptionAbort is thrown if modules running in
+   *  parallel add such data. All modules finish before the call returns.
+   *  Must be called before BeginJob, zero pointer disables concurrency.
+   */
+  void setBeginThreadPool(const boost::shared_ptr<ThreadPool>& threadPool);
+
+  /**
+   *  @brief Set time budgets for regular events.
+   *
+   *  If a module spends more than moduleBudget nanoseconds in event(), or
+   *  total time since the start of the event exceeds eventBudget, the event
+   *  is marked as skipped so that following modules (except those which
+   *  observe all events) do not see it, and overrun is counted. Zero value
+   *  disables corresponding budget. Budgets are not applied in batch mode.
+   */
+  void setTimeBudget(uint64_t moduleBudget, uint64_t eventBudget);
+
+  /**
+   *  @brief Enable product cache for cacheable modules.
+   *
+   *  For every module which declared itself cacheable (see
+   *  Module::setCacheable()) a ProductCache is opened in given directory.
+   *  When a cached record exists for an event, the module's event() is not
+   *  called, its products are restored with Module::loadProducts() and its
+   *  cached status is used. Otherwise event() is called and the products
+   *  are saved. Caches are shared with the copies made by clone(). Batch mode
+   *  does not use the cache. Empty directory name disables caching.
+   *
+   *  @param[in] dir         Directory for cache files
+   *  @param[in] experiment  Experiment name, caches of different experiments are kept apart
+   *  @throw ExceptionErrno if cache file cannot be opened
+   */
+  void setProductCache(const std::string& dir, const std::string& experiment);
+
+  /// Print hit and miss counts of product caches
+  void printCacheStats() const;
+
+  /// Returns number of module budget overruns for every module since last reset
+  const std::vector<unsigned long>& moduleOverruns() const { return m_moduleOverruns; }
+
+  /// Returns number of events which exceeded event budget since last reset
+  unsigned long eventOverruns() const { return m_eventOverruns; }
+
+  /// Reset overrun counters
+  void resetOverruns();
+
+  /**
+   *  @brief Call method corresponding to event type for all modules.
+   *
+   *  @param[in] evtType  Event type which defines method to call
+   *  @param[in] evt      Event object
+   *  @param[in] env      Environment object
+   *  @return Summary status of all modules
+   */
+  Module::Status call(EventLoop::EventType evtType, PSEvt::Event& evt, PSEnv::Env& env);
+
+  /**
+   *  @brief Call eventBatch() method for all modules.
+   *
+   *  Modules are called in order, skipped events are tracked by the batch
+   *  itself. If some module requests stop then remaining modules are still
+   *  called for events which preceded the stop.
+   *
+   *  @param[in] batch  Batch of regular events
+   *  @param[in] env    Environment object
+   *  @return Summary status of all modules, only OK, Stop or Abort
+   */
+  Module::Status callBatch(EventBatch& batch, PSEnv::Env& env);
+
+  /**
+   *  @brief Returns true if every module overrides Module::eventBatch().
+   *
+   *  Only available with GCC, otherwise always returns false.
+   */
+  bool processesBatches() const;
+
+  /**
+   *  @brief Set or clear the flag which marks event as skipped.
+   *
+   *  Used when the same event is passed to several independent chains so
+   *  that every chain starts with the event that is not skipped.
+   */
+  static void setSkipped(PSEvt::Event& evt, bool skipped);
+
+  /**
+   *  @brief Make a copy of this chain for use in a different thread.
+   *
+   *  Returns zero pointer if some module does not support cloning.
+   */
+  boost::shared_ptr<ModuleChain> clone() const;
+
+protected:
+
+private:
+
+  // Calls a method for one module, measures its time if profiling is enabled.
+  void callModule(unsigned index, EventLoop::EventType evtType, PSEvt::Event& evt, PSEnv::Env& env);
+
+  // Calls event() method for all modules according to schedule.
+  Module::Status callScheduled(PSEvt::Event& evt, PSEnv::Env& env);
+
+  // Calls transition method for all modules according to transition schedule.
+  Module::Status callTransitionScheduled(EventLoop::EventType evtType, PSEvt::Event& evt, PSEnv::Env& env);
+
+  // Check time budgets after module was called, marks event as skipped if budget is exceeded.
+  void checkBudget(unsigned index, uint64_t eventStart, bool& eventOverrun, Module::Status& stat);
+
+  // Marks event as skipped if it was not skipped yet.
+  void skipEvent(Module::Status& stat);
+
+  // Merges status of the module which processed regular event into summary status.
+  void updateStatus(const Module& mod, Module::Status& stat);
+
+  // Build schedule from module declarations.
+  void makeSchedule();
+
+  // Build schedules for begin transitions from module declarations.
+  void makeTransitionSchedule();
+
+  // Find level of every module in dependency graph, returns number of levels.
+  unsigned moduleLevels(std::vector<unsigned>& levels) const;
+
+  // Build lists of modules for every transition.
+  void makeDispatch();
+
+  // module index and module, raw pointer is owned by m_modules
+  typedef std::pair<unsigned, Module*> DispatchEntry;
+
+  std::vector<boost::shared_ptr<Module> > m_modules;
+  boost::shared_ptr<ModuleProfiler> m_profiler;
+  boost::shared_ptr<ThreadPool> m_threadPool;
+  std::vector<std::vector<unsigned> > m_schedule;  ///< module indices for each step, empty for sequential mode
+  std::vector<std::vector<DispatchEntry> > m_dispatch;  ///< modules to call for each event type
+  boost::shared_ptr<ThreadPool> m_beginThreadPool;
+  std::vector<std::vector<std::vector<DispatchEntry> > > m_transitionSchedule;  ///< steps for each event type, empty if sequential
+  uint64_t m_moduleBudget;                        ///< Time budget for one module in ns, 0 if not set
+  uint64_t m_eventBudget;                         ///< Time budget for one event in ns, 0 if not set
+  std::vector<uint64_t> m_elapsed;                ///< Time of last event() call for each module
+  std::vector<unsigned long> m_moduleOverruns;
+  unsigned long m_eventOverruns;
+  std::vector<boost::shared_ptr<ProductCache> > m_caches;  ///< cache for each module, zero if not cached
+};
+
+} // namespace psana
+
+#endif // PSANA_MODULECHAIN_H
@@ -0,0 +1,144 @@
+#ifndef PSANA_MODULEPROFILER_H
+#define PSANA_MODULEPROFILER_H
+
+//--------------------------------------------------------------------------
+// File and Version Information:
+//     $Id$
+//
+// Description:
+//     Class ModuleProfiler.
+//
+//------------------------------------------------------------------------
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/utility.hpp>
+
+//----------------------
+// Base Class Headers --
+//----------------------
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+
+//------------------------------------
+// Collaborating Class Declarations --
+//------------------------------------
+
+//             ---------------------
+//             -- Class Interface --
+//             ---------------------
+
+namespace psana {
+
+/// @addtogroup psana
+
+/**
+ *  @ingroup psana
+ *
+ *  @brief Collects timing statistics for user module calls.
+ *
+ *  Event loop creates an instance of this class when profiling is enabled
+ *  (psana.profile option) and records wall-clock and CPU time spent in
+ *  every call of every module method. Statistics are kept separately for
+ *  each module and each transition type, for every combination the number
+ *  of calls, total/min/max times and a log-scale histogram of wall time
+ *  are accumulated, histogram is used to estimate percentiles. When
+ *  profiling is disabled event loop does not have an instance of this
+ *  class and no clock is read at all.
+ *
+ *  This software was developed for the LCLS project.  If you use all or
+ *  part of it, please give an appropriate acknowledgment.
+ *
+ *  @version $Id$
+ *
+ *  @author Andy Salnikov
+ */
+
+class ModuleProfiler : boost::noncopyable {
+public:
+
+  /// Pair of timestamps (in nanoseconds) taken before the call
+  struct Stamp {
+    uint64_t wall;  ///< monotonic wall clock
+    uint64_t cpu;   ///< CPU time of the calling thread
+  };
+
+  /**
+   *  @brief Constructor takes the names of transitions.
+   *
+   *  Transition index passed to record() is an index in this list.
+   */
+  explicit ModuleProfiler(const std::vector<std::string>& transitions);
+
+  // Destructor
+  ~ModuleProfiler();
+
+  /// Returns current wall-clock and thread CPU time
+  static Stamp now();
+
+  /**
+   *  @brief Record the time of one call.
+   *
+   *  @param[in] module     Index of the module in the module list
+   *  @param[in] transition Index of the transition type
+   *  @param[in] start      Value returned from now() just before the call
+   *
+   *  This method can be called concurrently from multiple threads.
+   */
+  void record(unsigned module, unsigned transition, const Stamp& start);
+
+  /**
+   *  @brief Print the table with all collected statistics.
+   *
+   *  @param[in] out      Output stream
+   *  @param[in] modules  Names of the modules, index in this list is a module index
+   */
+  void print(std::ostream& out, const std::vector<std::string>& modules) const;
+
+  /**
+   *  @brief Dump statistics to a file as tab-separated table.
+   *
+   *  @param[in] path     File name
+   *  @param[in] modules  Names of the modules, index in this list is a module index
+   *  @return false if file cannot be written
+   */
+  bool dump(const std::string& path, const std::vector<std::string>& modules) const;
+
+protected:
+
+private:
+
+  // statistics for one module/transition combination
+  struct Stats {
+    Stats() : calls(0), wallSum(0), cpuSum(0), wallMin(0), wallMax(0) {}
+
+    /// Returns estimate for given quantile of wall time (0 < q < 1)
+    uint64_t quantile(double q) const;
+
+    uint64_t calls;
+    uint64_t wallSum;
+    uint64_t cpuSum;
+    uint64_t wallMin;
+    uint64_t wallMax;
+    std::vector<uint64_t> hist;   ///< histogram of wall times, allocated on first use
+  };
+
+  // formats one table, separator is used between columns
+  void format(std::ostream& out, const std::vector<std::string>& modules, bool tsv) const;
+
+  std::vector<std::string> m_transitions;        ///< names of the transitions
+  std::vector<std::vector<Stats> > m_stats;      ///< statistics indexed by [module][transition]
+  boost::mutex m_mutex;                          ///< protects m_stats in record()
+};
+
+} // namespace psana
+
+#endif // PSANA_MODULEPROFILER_H
@@ -29,6 +29,7 @@
 //-------------------------------
 #include "AppUtils/AppCmdArgList.h"
 #include "AppUtils/AppCmdOpt.h"
+#include "AppUtils/AppCmdOptBool.h"
 #include "AppUtils/AppCmdOptList.h"
 #include "psana/Module.h"
 #include "PSEnv/Env.h"
@@ -113,6 +114,7 @@ private:
   AppUtils::AppCmdOpt<unsigned> m_maxEventsOpt ;
   AppUtils::AppCmdOpt<unsigned> m_skipEventsOpt ;
   AppUtils::AppCmdOpt<unsigned> m_parallelOpt;
+  AppUtils::AppCmdOptBool m_restartOpt;
   AppUtils::AppCmdOptList<std::string> m_optionsOpt;
   AppUtils::AppCmdArgList<std::string>  m_datasets;
 };
@@ -0,0 +1,163 @@
+#ifndef PSANA_PRODUCTCACHE_H
+#define PSANA_PRODUCTCACHE_H
+
+//--------------------------------------------------------------------------
+// File and Version Information:
+//     $Id$
+//
+// Description:
+//     Class ProductCache.
+//
+//------------------------------------------------------------------------
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+#include <fstream>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/utility.hpp>
+
+//----------------------
+// Base Class Headers --
+//----------------------
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+#include "psana/Module.h"
+#include "PSEvt/Event.h"
+
+//------------------------------------
+// Collaborating Class Declarations --
+//------------------------------------
+
+//             ---------------------
+//             -- Class Interface --
+//             ---------------------
+
+namespace psana {
+
+/// @addtogroup psana
+
+/**
+ *  @ingroup psana
+ *
+ *  @brief On-disk cache of event products of one module.
+ *
+ *  Cache is a set of files which contain records keyed by run number and
+ *  event time. Every record keeps status of the module and data saved by
+ *  the module (see Module::saveProducts()). Names of the files are built
+ *  from module name, hash of its configuration and experiment name, so
+ *  changing configuration or analyzing other experiment starts a new
+ *  cache. Every process writes its own file (host name and process ID are
+ *  added to the file name) so that several jobs or workers of the same job
+ *  can share one directory. Index of all records in all files of the cache
+ *  is read when cache is opened, new records are appended to the end of
+ *  process' own file. Incomplete record at the end of a file (e.g. after
+ *  crash or written by a running process) is ignored.
+ *
+ *  All methods are thread-safe, the same cache is shared by all copies of
+ *  the module in multi-threaded mode.
+ *
+ *  This software was developed for the LCLS project.  If you use all or
+ *  part of it, please give an appropriate acknowledgment.
+ *
+ *  @version $Id$
+ *
+ *  @author Andy Salnikov
+ */
+
+class ProductCache : boost::noncopyable {
+public:
+
+  /// Event identification used as a key
+  struct Key {
+    Key() : run(0), sec(0), nsec(0), fiducials(0) {}
+    Key(uint32_t run, uint32_t sec, uint32_t nsec, uint32_t fiducials)
+      : run(run), sec(sec), nsec(nsec), fiducials(fiducials) {}
+    bool operator<(const Key& other) const {
+      if (run != other.run) return run < other.run;
+      if (sec != other.sec) return sec < other.sec;
+      if (nsec != other.nsec) return nsec < other.nsec;
+      return fiducials < other.fiducials;
+    }
+    uint32_t run;
+    uint32_t sec;
+    uint32_t nsec;
+    uint32_t fiducials;
+  };
+
+  /**
+   *  @brief Constructor reads existing cache files and creates own file.
+   *
+   *  @param[in] dir        Directory for cache files, created if does not exist
+   *  @param[in] module     Module whose products are cached
+   *  @param[in] experiment Experiment name, may be empty
+   *  @throw ExceptionErrno if own file cannot be opened
+   *  @throw ExceptionAbort if own file exists and is not a product cache
+   */
+  ProductCache(const std::string& dir, const Module& module, const std::string& experiment);
+
+  // Destructor
+  ~ProductCache();
+
+  /// Returns path of the file where new records are written
+  const std::string& path() const { return m_paths.front(); }
+
+  /// Build key from event id, returns false if event does not have id
+  static bool makeKey(PSEvt::Event& evt, Key& key);
+
+  /**
+   *  @brief Find record for given event.
+   *
+   *  Returns true and fills status and data if record is found, counts hits
+   *  and misses.
+   */
+  bool find(const Key& key, Module::Status& status, std::string& data);
+
+  /// Add new record to the cache, existing records are not replaced
+  void store(const Key& key, Module::Status status, const std::string& data);
+
+  /// Returns number of successful lookups
+  unsigned long nHits() const;
+
+  /// Returns number of failed lookups
+  unsigned long nMisses() const;
+
+protected:
+
+private:
+
+  // Location of one record in the files
+  struct Record {
+    Record() : file(0), offset(0), size(0), status(0) {}
+    Record(unsigned file, uint64_t offset, uint32_t size, uint32_t status)
+      : file(file), offset(offset), size(size), status(status) {}
+    unsigned file;    ///< Index of the file
+    uint64_t offset;  ///< Offset of the data in file
+    uint32_t size;    ///< Size of the data
+    uint32_t status;  ///< Module status
+  };
+
+  // Read index of all complete records in one file, returns offset of the
+  // end of last complete record or 0 if file is not a product cache
+  uint64_t readIndex(unsigned file);
+
+  std::vector<std::string> m_paths;  ///< Paths of all files, first is own file
+  std::vector<boost::shared_ptr<std::fstream> > m_files;
+  std::map<Key, Record> m_index;
+  uint64_t m_end;            ///< Offset of the end of last complete record in own file
+  unsigned long m_nHits;
+  unsigned long m_nMisses;
+  mutable boost::mutex m_mutex;
+};
+
+} // namespace psana
+
+#endif // PSANA_PRODUCTCACHE_H
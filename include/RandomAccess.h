@@ -25,6 +25,25 @@ public:
   virtual ~RandomAccess() {}
   virtual int      jump(const std::vector<std::string>& filenames, const std::vector<int64_t> &offsets, const std::string &lastBeginCalibCycleDgram, uintptr_t runtime, uintptr_t ctx)  = 0;
   virtual void     setrun(int run)                                    = 0;
+
+  /// Position of one event, same as the arguments of jump()
+  struct Position {
+    std::vector<std::string> filenames;
+    std::vector<int64_t> offsets;
+    std::string lastBeginCalibCycleDgram;
+  };
+
+  /**
+   *  @brief Position input at a batch of events.
+   *
+   *  Following events are returned by input in the order of positions.
+   *  Implementation is expected to sort reads by file and offset and to
+   *  merge nearby reads into larger requests (see ReadPlan), which is much
+   *  faster than one jump() per event on spinning disks and Lustre.
+   *  Returns 0 on success. Default implementation does not support batches
+   *  and returns -1, caller should fall back to jump().
+   */
+  virtual int      jumpBatch(const std::vector<Position>& positions, uintptr_t runtime, uintptr_t ctx) { return -1; }
 };
 
 }
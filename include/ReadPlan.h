@@ -0,0 +1,130 @@
+#ifndef PSANA_READPLAN_H
+#define PSANA_READPLAN_H
+
+//--------------------------------------------------------------------------
+// File and Version Information:
+//     $Id$
+//
+// Description:
+//     Class ReadPlan.
+//
+//------------------------------------------------------------------------
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+
+//----------------------
+// Base Class Headers --
+//----------------------
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+#include "psana/RandomAccess.h"
+
+//------------------------------------
+// Collaborating Class Declarations --
+//------------------------------------
+
+//             ---------------------
+//             -- Class Interface --
+//             ---------------------
+
+namespace psana {
+
+/// @addtogroup psana
+
+/**
+ *  @ingroup psana
+ *
+ *  @brief Plan of coalesced reads for a batch of random-access events.
+ *
+ *  Every event consists of datagrams at given offsets in one or more files
+ *  (the same information which is passed to RandomAccess::jump()). Plan
+ *  sorts all datagrams by file and offset and merges datagrams which are
+ *  close to each other into one read, so that input module issues a few
+ *  large sequential reads instead of one seek and read per datagram. Each
+ *  read remembers which datagrams it contains and where they are located
+ *  in the read buffer, so that events can be assembled and returned in the
+ *  original order.
+ *
+ *  Size of the datagram is not known before it is read, plan assumes that
+ *  every datagram is not larger than sizeHint; input module has to read
+ *  the rest of a datagram if its header says it is larger.
+ *
+ *  This software was developed for the LCLS project.  If you use all or
+ *  part of it, please give an appropriate acknowledgment.
+ *
+ *  @version $Id$
+ *
+ *  @author Andy Salnikov
+ */
+
+class ReadPlan {
+public:
+
+  /// One datagram inside a read
+  struct Piece {
+    unsigned event;      ///< Index of the event in the batch
+    unsigned file;       ///< Index of the file in event's file list
+    int64_t offset;      ///< Offset of datagram in file
+  };
+
+  /// One read request, contiguous range of one file
+  struct Read {
+    std::string filename;
+    int64_t begin;               ///< Offset of the first byte to read
+    int64_t end;                 ///< Offset after the last byte to read
+    std::vector<Piece> pieces;   ///< Datagrams in this range ordered by offset
+  };
+
+  /**
+   *  @brief Constructor takes merging parameters.
+   *
+   *  @param[in] maxGap    Reads are merged if the gap between them is not larger than this
+   *  @param[in] maxSize   Merged read is never larger than this, unless single datagram is
+   *  @param[in] sizeHint  Expected maximum size of one datagram
+   */
+  ReadPlan(int64_t maxGap = 1 << 20, int64_t maxSize = 64 << 20, int64_t sizeHint = 1 << 20)
+    : m_maxGap(maxGap), m_maxSize(maxSize), m_sizeHint(sizeHint), m_pieces(), m_nEvents(0) {}
+
+  /// Add one event, returns its index in the batch
+  unsigned add(const std::vector<std::string>& filenames, const std::vector<int64_t>& offsets);
+
+  /// Add one event, returns its index in the batch
+  unsigned add(const RandomAccess::Position& position) { return add(position.filenames, position.offsets); }
+
+  /// Returns number of events in the batch
+  unsigned size() const { return m_nEvents; }
+
+  /// Build list of reads ordered by file name and offset
+  std::vector<Read> reads() const;
+
+protected:
+
+private:
+
+  // Datagram with its file name
+  struct FilePiece {
+    std::string filename;
+    Piece piece;
+    bool operator<(const FilePiece& other) const {
+      if (filename != other.filename) return filename < other.filename;
+      return piece.offset < other.piece.offset;
+    }
+  };
+
+  int64_t m_maxGap;
+  int64_t m_maxSize;
+  int64_t m_sizeHint;
+  std::vector<FilePiece> m_pieces;
+  unsigned m_nEvents;
+};
+
+} // namespace psana
+
+#endif // PSANA_READPLAN_H
@@ -0,0 +1,108 @@
+#ifndef PSANA_THREADPOOL_H
+#define PSANA_THREADPOOL_H
+
+//--------------------------------------------------------------------------
+// File and Version Information:
+//     $Id$
+//
+// Description:
+//     Class ThreadPool.
+//
+//------------------------------------------------------------------------
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/utility.hpp>
+
+//----------------------
+// Base Class Headers --
+//----------------------
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+
+//------------------------------------
+// Collaborating Class Declarations --
+//------------------------------------
+
+//             ---------------------
+//             -- Class Interface --
+//             ---------------------
+
+namespace psana {
+
+/// @addtogroup psana
+
+/**
+ *  @ingroup psana
+ *
+ *  @brief Simple fork-join pool of threads.
+ *
+ *  Pool starts fixed number of threads in constructor which wait for the
+ *  work. Method run() distributes a set of tasks between threads and
+ *  returns when all tasks are finished. If any of the tasks throws an
+ *  exception then remaining tasks are still executed and psana::Exception
+ *  with the message of the first exception is thrown from run().
+ *
+ *  This software was developed for the LCLS project.  If you use all or
+ *  part of it, please give an appropriate acknowledgment.
+ *
+ *  @version $Id$
+ *
+ *  @author Andy Salnikov
+ */
+
+class ThreadPool : boost::noncopyable {
+public:
+
+  typedef boost::function<void ()> Task;
+
+  /// Constructor starts given number of threads
+  explicit ThreadPool(unsigned nThreads);
+
+  // Destructor stops all threads
+  ~ThreadPool();
+
+  /// Returns number of threads in the pool
+  unsigned size() const { return m_threads.size(); }
+
+  /**
+   *  @brief Execute all tasks and wait until they finish.
+   *
+   *  Order in which tasks are started is the same as order in the vector,
+   *  but they may finish in any order. Must not be called concurrently
+   *  from different threads.
+   *
+   *  @throw psana::Exception if any task throws an exception
+   */
+  void run(const std::vector<Task>& tasks);
+
+protected:
+
+private:
+
+  // body of the worker thread
+  void worker();
+
+  std::vector<boost::thread*> m_threads;
+  const std::vector<Task>* m_tasks;   ///< tasks currently being executed
+  unsigned m_next;                    ///< index of the next task to start
+  unsigned m_running;                 ///< number of tasks started but not finished
+  bool m_stop;
+  std::string m_error;                ///< message from first failed task
+  boost::mutex m_mutex;
+  boost::condition_variable m_workCond;
+  boost::condition_variable m_doneCond;
+};
+
+} // namespace psana
+
+#endif // PSANA_THREADPOOL_H
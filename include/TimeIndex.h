@@ -0,0 +1,188 @@
+#ifndef PSANA_TIMEINDEX_H
+#define PSANA_TIMEINDEX_H
+
+//--------------------------------------------------------------------------
+// File and Version Information:
+//     $Id$
+//
+// Description:
+//     Class TimeIndex.
+//
+//------------------------------------------------------------------------
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+
+//----------------------
+// Base Class Headers --
+//----------------------
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+#include "psana/EventTime.h"
+#include "psana/Index.h"
+
+//------------------------------------
+// Collaborating Class Declarations --
+//------------------------------------
+
+//             ---------------------
+//             -- Class Interface --
+//             ---------------------
+
+namespace psana {
+
+/// @addtogroup psana
+
+/**
+ *  @ingroup psana
+ *
+ *  @brief Persistent memory-mapped index of event times.
+ *
+ *  Index file contains, for every event, its time, fiducial, number of
+ *  the file which contains the event and offset of the event datagram in
+ *  that file. Entries are sorted by time, table of steps (calib cycles)
+ *  keeps index of first entry in every step, and list of runs is saved
+ *  too. File is written once with TimeIndex::Writer, e.g. after the first
+ *  scan of small data, and is memory-mapped by every later job so that
+ *  opening it takes constant time and finding an event is a binary search.
+ *
+ *  Input module which implements Index interface can use this class to
+ *  answer nsteps(), times() and runs() and to find file and offset for
+ *  Index::jump(). Lists of EventTime objects required by Index::times()
+ *  are only built when requested.
+ *
+ *  This software was developed for the LCLS project.  If you use all or
+ *  part of it, please give an appropriate acknowledgment.
+ *
+ *  @version $Id$
+ *
+ *  @author Andy Salnikov
+ */
+
+class TimeIndex : boost::noncopyable {
+public:
+
+  /// One index entry as stored in file
+  struct Entry {
+    uint64_t time;      ///< Event time, same as EventTime::time()
+    uint32_t fiducial;  ///< Event fiducial
+    uint32_t file;      ///< File number
+    int64_t offset;     ///< Offset of event datagram in file
+  };
+
+  /// Range of offsets in one file which contains all selected events from that file
+  struct Span {
+    uint32_t file;      ///< File number
+    int64_t begin;      ///< Offset of first selected event
+    int64_t last;       ///< Offset of last selected event
+    uint64_t nEvents;   ///< Number of selected events in this file
+  };
+
+  /**
+   *  @brief Collects entries and writes index file.
+   *
+   *  Events are added in the order of steps, entries within a step are
+   *  sorted when file is written. Steps must not overlap in time.
+   */
+  class Writer {
+  public:
+
+    Writer() : m_entries(), m_stepBegin(), m_runs() {}
+
+    /// Start new step, following events belong to this step
+    void addStep() { m_stepBegin.push_back(m_entries.size()); }
+
+    /// Add one event to current step
+    void add(const EventTime& time, uint32_t file, int64_t offset);
+
+    /// Add run number to the list of runs
+    void addRun(unsigned run) { m_runs.push_back(run); }
+
+    /**
+     *  @brief Write index file.
+     *
+     *  File is written under a temporary name and renamed, so that readers
+     *  never see incomplete file.
+     *
+     *  @throw ExceptionAbort if steps overlap in time
+     *  @throw ExceptionErrno if file cannot be written
+     */
+    void write(const std::string& path);
+
+  private:
+    std::vector<Entry> m_entries;
+    std::vector<uint64_t> m_stepBegin;
+    std::vector<uint32_t> m_runs;
+  };
+
+  /**
+   *  @brief Open and memory-map index file.
+   *
+   *  @throw ExceptionErrno if file cannot be opened or has wrong format
+   */
+  explicit TimeIndex(const std::string& path);
+
+  // Destructor
+  ~TimeIndex();
+
+  /// Returns number of events
+  uint64_t size() const { return m_nEntries; }
+
+  /// Returns entry with given index
+  const Entry& entry(uint64_t index) const { return m_entries[index]; }
+
+  /// Find entry for given event time, returns zero pointer if event is not in index
+  const Entry* find(const EventTime& time) const;
+
+  /**
+   *  @brief Find file spans for events in time window [t0, t1).
+   *
+   *  Events in one file are ordered in time, so all events from the window
+   *  which are in one file occupy one contiguous range of offsets. Spans are
+   *  returned ordered by file number, files without selected events are not
+   *  included. Fiducials are ignored when comparing with window limits.
+   *
+   *  @return Total number of selected events
+   */
+  uint64_t select(const EventTime& t0, const EventTime& t1, std::vector<Span>& spans) const;
+
+  /// Returns number of steps
+  unsigned nsteps() const { return m_nSteps; }
+
+  /// Returns range of entry indices [begin, end) for given step
+  void stepRange(unsigned step, uint64_t& begin, uint64_t& end) const;
+
+  /// Returns times of all events, same as Index::times()
+  void times(Index::EventTimeIter& begin, Index::EventTimeIter& end);
+
+  /// Returns times of events in one step, same as Index::times(step, ...)
+  void times(unsigned step, Index::EventTimeIter& begin, Index::EventTimeIter& end);
+
+  /// Returns list of runs
+  const std::vector<unsigned>& runs() const { return m_runs; }
+
+protected:
+
+private:
+
+  std::string m_path;
+  void* m_addr;                   ///< Address of mapped file
+  size_t m_mapSize;               ///< Size of mapped file
+  const Entry* m_entries;         ///< Entries in mapped memory
+  uint64_t m_nEntries;
+  const uint64_t* m_stepBegin;    ///< First entry of every step in mapped memory
+  unsigned m_nSteps;
+  std::vector<unsigned> m_runs;
+  std::vector<EventTime> m_times; ///< Times of all events, built on first request
+};
+
+} // namespace psana
+
+#endif // PSANA_TIMEINDEX_H
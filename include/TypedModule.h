@@ -0,0 +1,266 @@
+#ifndef PSANA_TYPEDMODULE_H
+#define PSANA_TYPEDMODULE_H
+
+//--------------------------------------------------------------------------
+// File and Version Information:
+//     $Id$
+//
+// Description:
+//     Class template TypedModule.
+//
+//------------------------------------------------------------------------
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+#include <string>
+#include <boost/lexical_cast.hpp>
+#include <boost/shared_ptr.hpp>
+
+//----------------------
+// Base Class Headers --
+//----------------------
+#include "psana/Module.h"
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+#include "PSEvt/Source.h"
+#include "psana/Exceptions.h"
+
+//------------------------------------
+// Collaborating Class Declarations --
+//------------------------------------
+
+//             ---------------------
+//             -- Class Interface --
+//             ---------------------
+
+namespace psana {
+
+/// @addtogroup psana
+
+/**
+ *  @ingroup psana
+ *
+ *  @brief Base class for modules with fixed set of typed event inputs.
+ *
+ *  Common part of all TypedModule specializations. It keeps source and key
+ *  for each input and the exact source address which was found for that
+ *  input. Source is resolved when data is found in event for the first
+ *  time, after that data is looked up by exact address which avoids alias
+ *  resolution and source matching on every event. Resolved addresses are
+ *  forgotten in beginRun() as aliases and available sources can change
+ *  between runs; subclasses which override beginRun() must call
+ *  TypedModuleBase::beginRun(). If data disappears from that address
+ *  source is resolved again.
+ *
+ *  This software was developed for the LCLS project.  If you use all or
+ *  part of it, please give an appropriate acknowledgment.
+ *
+ *  @version $Id$
+ *
+ *  @author Andy Salnikov
+ */
+
+template <unsigned NInputs>
+class TypedModuleBase : public Module {
+public:
+
+  /// Returns source of the input with given index
+  const PSEvt::Source& inputSource(unsigned index) const { return m_inputs[index].source; }
+
+  /// Returns key of the input with given index
+  const std::string& inputKey(unsigned index) const { return m_inputs[index].key; }
+
+  /// Forgets resolved addresses, sources are resolved again in the new run
+  virtual void beginRun(Event& evt, Env& env) {
+    for (unsigned i = 0; i != NInputs; ++ i) m_inputs[i].resolved = false;
+  }
+
+protected:
+
+  /// Constructor takes module name
+  TypedModuleBase(const std::string& name, bool observeAllEvents)
+    : Module(name, observeAllEvents) {}
+
+  /**
+   *  @brief Define source and key for the input with given index.
+   *
+   *  Should be called in constructor or beginJob(), usually with values
+   *  from configuration, e.g. bindInput(0, configSrc("source", "DetInfo(:Evr)")).
+   *  Throws ExceptionAbort if index is not less than the number of inputs.
+   */
+  void bindInput(unsigned index, const PSEvt::Source& source, const std::string& key = std::string()) {
+    if (index >= NInputs) {
+      throw ExceptionAbort(ERR_LOC, "TypedModule::bindInput: input index " + boost::lexical_cast<std::string>(index) +
+          " is out of range, module " + name() + " has " + boost::lexical_cast<std::string>(NInputs) + " inputs");
+    }
+    m_inputs[index] = Input(source, key);
+  }
+
+  /// Returns data for the input with given index, zero pointer if data is missing
+  template <typename T>
+  boost::shared_ptr<T> input(PSEvt::Event& evt, unsigned index) {
+    Input& in = m_inputs[index];
+    if (in.resolved) {
+      boost::shared_ptr<T> data = evt.get(in.src, in.key);
+      if (data) return data;
+    }
+    Pds::Src src;
+    boost::shared_ptr<T> data = evt.get(in.source, in.key, &src);
+    if (data) {
+      in.src = src;
+      in.resolved = true;
+    }
+    return data;
+  }
+
+private:
+
+  // Binding of one input
+  struct Input {
+    Input() : source(), key(), src(), resolved(false) {}
+    Input(const PSEvt::Source& source, const std::string& key)
+      : source(source), key(key), src(), resolved(false) {}
+    PSEvt::Source source;  ///< Source as given by user, may be a pattern or alias
+    std::string key;
+    Pds::Src src;          ///< Exact address of the data, valid if resolved is true
+    bool resolved;
+  };
+
+  Input m_inputs[NInputs];
+};
+
+/**
+ *  @ingroup psana
+ *
+ *  @brief Base class for user modules which read fixed set of typed data.
+ *
+ *  Template parameters are types of event data which module needs, up to
+ *  four types are supported. Subclass defines source and key of every input
+ *  with bindInput() and implements event() method which receives references
+ *  to the data. Typed event() hides event(Event&, Env&) inherited from this
+ *  class, subclass should bring it back with a using declaration to avoid
+ *  -Woverloaded-virtual warnings, e.g.:
+ *
+ *  @code
+ *  class MyModule : public TypedModule<Psana::EvrData::DataV3, Psana::Bld::BldDataEBeamV3> {
+ *  public:
+ *    using TypedModule<Psana::EvrData::DataV3, Psana::Bld::BldDataEBeamV3>::event;
+ *    MyModule(const std::string& name) : TypedModule<...>(name) {
+ *      bindInput(0, configSrc("evrSource", "DetInfo(:Evr)"));
+ *      bindInput(1, configSrc("ebeamSource", "BldInfo(EBeam)"));
+ *    }
+ *    virtual void event(const Psana::EvrData::DataV3& evr, const Psana::Bld::BldDataEBeamV3& ebeam,
+ *        Event& evt, Env& env);
+ *  };
+ *  PSANA_MODULE_FACTORY(MyModule)
+ *  @endcode
+ *
+ *  If any of the inputs is missing from event then typed event() method is
+ *  not called for that event. Module is created with PSANA_MODULE_FACTORY
+ *  like any other module.
+ *
+ *  This software was developed for the LCLS project.  If you use all or
+ *  part of it, please give an appropriate acknowledgment.
+ *
+ *  @version $Id$
+ *
+ *  @author Andy Salnikov
+ */
+
+template <typename T1, typename T2 = void, typename T3 = void, typename T4 = void>
+class TypedModule : public TypedModuleBase<4> {
+public:
+
+  /// Method called for every event which has all inputs
+  virtual void event(const T1& d1, const T2& d2, const T3& d3, const T4& d4, Event& evt, Env& env) = 0;
+
+  /// Finds all inputs and calls typed event() method
+  virtual void event(Event& evt, Env& env) {
+    boost::shared_ptr<T1> d1 = this->template input<T1>(evt, 0);
+    if (not d1) return;
+    boost::shared_ptr<T2> d2 = this->template input<T2>(evt, 1);
+    if (not d2) return;
+    boost::shared_ptr<T3> d3 = this->template input<T3>(evt, 2);
+    if (not d3) return;
+    boost::shared_ptr<T4> d4 = this->template input<T4>(evt, 3);
+    if (d4) event(*d1, *d2, *d3, *d4, evt, env);
+  }
+
+protected:
+
+  TypedModule(const std::string& name, bool observeAllEvents = false)
+    : TypedModuleBase<4>(name, observeAllEvents) {}
+};
+
+/// Specialization for three inputs
+template <typename T1, typename T2, typename T3>
+class TypedModule<T1, T2, T3, void> : public TypedModuleBase<3> {
+public:
+
+  /// Method called for every event which has all inputs
+  virtual void event(const T1& d1, const T2& d2, const T3& d3, Event& evt, Env& env) = 0;
+
+  /// Finds all inputs and calls typed event() method
+  virtual void event(Event& evt, Env& env) {
+    boost::shared_ptr<T1> d1 = this->template input<T1>(evt, 0);
+    if (not d1) return;
+    boost::shared_ptr<T2> d2 = this->template input<T2>(evt, 1);
+    if (not d2) return;
+    boost::shared_ptr<T3> d3 = this->template input<T3>(evt, 2);
+    if (d3) event(*d1, *d2, *d3, evt, env);
+  }
+
+protected:
+
+  TypedModule(const std::string& name, bool observeAllEvents = false)
+    : TypedModuleBase<3>(name, observeAllEvents) {}
+};
+
+/// Specialization for two inputs
+template <typename T1, typename T2>
+class TypedModule<T1, T2, void, void> : public TypedModuleBase<2> {
+public:
+
+  /// Method called for every event which has all inputs
+  virtual void event(const T1& d1, const T2& d2, Event& evt, Env& env) = 0;
+
+  /// Finds all inputs and calls typed event() method
+  virtual void event(Event& evt, Env& env) {
+    boost::shared_ptr<T1> d1 = this->template input<T1>(evt, 0);
+    if (not d1) return;
+    boost::shared_ptr<T2> d2 = this->template input<T2>(evt, 1);
+    if (d2) event(*d1, *d2, evt, env);
+  }
+
+protected:
+
+  TypedModule(const std::string& name, bool observeAllEvents = false)
+    : TypedModuleBase<2>(name, observeAllEvents) {}
+};
+
+/// Specialization for one input
+template <typename T1>
+class TypedModule<T1, void, void, void> : public TypedModuleBase<1> {
+public:
+
+  /// Method called for every event which has the input
+  virtual void event(const T1& d1, Event& evt, Env& env) = 0;
+
+  /// Finds input and calls typed event() method
+  virtual void event(Event& evt, Env& env) {
+    boost::shared_ptr<T1> d1 = this->template input<T1>(evt, 0);
+    if (d1) event(*d1, evt, env);
+  }
+
+protected:
+
+  TypedModule(const std::string& name, bool observeAllEvents = false)
+    : TypedModuleBase<1>(name, observeAllEvents) {}
+};
+
+} // namespace psana
+
+#endif // PSANA_TYPEDMODULE_H
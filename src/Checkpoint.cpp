@@ -0,0 +1,157 @@
+//--------------------------------------------------------------------------
+// File and Version Information:
+//     $Id$
+//
+// Description:
+//     Class Checkpoint...
+//
+// Author List:
+//     Andy Salnikov
+//
+//------------------------------------------------------------------------
+
+//-----------------------
+// This Class's Header --
+//-----------------------
+#include "psana/Checkpoint.h"
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+#include <stdio.h>
+#include <unistd.h>
+#include <cstring>
+#include <fstream>
+#include <boost/format.hpp>
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+#include "psana/Exceptions.h"
+
+//-----------------------------------------------------------------------
+// Local Macros, Typedefs, Structures, Unions and Forward Declarations --
+//-----------------------------------------------------------------------
+
+namespace {
+
+  // file starts with this string, change it if format changes
+  const char magic[] = "PSCKPT01";
+  const unsigned magicSize = sizeof magic - 1;
+
+  void writeInt(std::ostream& out, uint64_t value)
+  {
+    out.write((const char*)&value, sizeof value);
+  }
+
+  void writeStr(std::ostream& out, const std::string& str)
+  {
+    writeInt(out, str.size());
+    out.write(str.data(), str.size());
+  }
+
+  bool readInt(std::istream& in, uint64_t& value)
+  {
+    return bool(in.read((char*)&value, sizeof value));
+  }
+
+  // size of the string is checked against the size of the file
+  // before anything is allocated
+  bool readStr(std::istream& in, std::string& str, uint64_t fileSize)
+  {
+    uint64_t size;
+    if (not readInt(in, size) or size > fileSize) return false;
+    str.resize(size);
+    if (size > 0) in.read(&str[0], size);
+    return bool(in);
+  }
+
+}
+
+//             ----------------------------------------
+//             -- Public Function Member Definitions --
+//             ----------------------------------------
+
+namespace psana {
+
+// Save checkpoint to a file, replacing existing file.
+void
+Checkpoint::write(const std::string& path) const
+{
+  // temporary file is unique to the process so that jobs writing the
+  // same checkpoint do not overwrite each other's temporary files
+  const std::string tmpPath = boost::str(boost::format("%1%.tmp.%2%") % path % getpid());
+  std::ofstream out(tmpPath.c_str(), std::ios::binary | std::ios::trunc);
+
+  out.write(::magic, ::magicSize);
+  ::writeInt(out, uint64_t(int64_t(run)));
+  ::writeInt(out, filenames.size());
+  for (unsigned i = 0; i != filenames.size(); ++ i) {
+    ::writeStr(out, filenames[i]);
+    ::writeInt(out, i < offsets.size() ? uint64_t(offsets[i]) : 0);
+  }
+  ::writeStr(out, lastBeginCalibCycleDgram);
+  ::writeInt(out, moduleStates.size());
+  for (std::map<std::string, std::string>::const_iterator it = moduleStates.begin(); it != moduleStates.end(); ++ it) {
+    ::writeStr(out, it->first);
+    ::writeStr(out, it->second);
+  }
+
+  out.close();
+  if (not out) {
+    throw ExceptionErrno(ERR_LOC, "failed to write checkpoint file " + tmpPath);
+  }
+  if (rename(tmpPath.c_str(), path.c_str()) != 0) {
+    throw ExceptionErrno(ERR_LOC, "failed to rename checkpoint file " + tmpPath + " to " + path);
+  }
+}
+
+// Read checkpoint from a file.
+bool
+Checkpoint::read(const std::string& path)
+{
+  std::ifstream in(path.c_str(), std::ios::binary);
+  if (not in) return false;
+
+  in.seekg(0, std::ios::end);
+  const uint64_t fileSize = in.tellg();
+  in.seekg(0);
+
+  char buf[::magicSize];
+  in.read(buf, ::magicSize);
+  if (not in or std::memcmp(buf, ::magic, ::magicSize) != 0) {
+    throw ExceptionAbort(ERR_LOC, "file " + path + " is not a checkpoint file");
+  }
+
+  bool ok = true;
+  uint64_t value = 0;
+  ok = ok and ::readInt(in, value);
+  run = int(int64_t(value));
+
+  uint64_t nFiles = 0;
+  ok = ok and ::readInt(in, nFiles) and nFiles <= fileSize;
+  filenames.clear();
+  offsets.clear();
+  for (uint64_t i = 0; ok and i != nFiles; ++ i) {
+    std::string name;
+    ok = ok and ::readStr(in, name, fileSize) and ::readInt(in, value);
+    filenames.push_back(name);
+    offsets.push_back(int64_t(value));
+  }
+  ok = ok and ::readStr(in, lastBeginCalibCycleDgram, fileSize);
+
+  uint64_t nModules = 0;
+  ok = ok and ::readInt(in, nModules) and nModules <= fileSize;
+  moduleStates.clear();
+  for (uint64_t i = 0; ok and i != nModules; ++ i) {
+    std::string name;
+    ok = ok and ::readStr(in, name, fileSize) and ::readStr(in, moduleStates[name], fileSize);
+  }
+
+  if (not ok) {
+    throw ExceptionAbort(ERR_LOC, "checkpoint file " + path + " is truncated or corrupted");
+  }
+  return true;
+}
+
+} // namespace psana
@@ -50,6 +50,11 @@ DataSource::DataSource (const boost::shared_ptr<InputModule>& inputModule,
 {
 }
 
+DataSource::DataSource (const boost::shared_ptr<EventLoop>& evtLoop)
+  : m_evtLoop(evtLoop)
+{
+}
+
 bool DataSource::liveAvail(int numEvents) {
   return m_evtLoop->liveAvail(numEvents);
 }
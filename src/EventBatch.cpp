@@ -0,0 +1,75 @@
+//--------------------------------------------------------------------------
+// File and Version Information:
+//     $Id$
+//
+// Description:
+//     Class EventBatch...
+//
+// Author List:
+//     Andy Salnikov
+//
+//------------------------------------------------------------------------
+
+//-----------------------
+// This Class's Header --
+//-----------------------
+#include "psana/EventBatch.h"
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+
+//-----------------------------------------------------------------------
+// Local Macros, Typedefs, Structures, Unions and Forward Declarations --
+//-----------------------------------------------------------------------
+
+//             ----------------------------------------
+//             -- Public Function Member Definitions --
+//             ----------------------------------------
+
+namespace psana {
+
+//----------------
+// Constructors --
+//----------------
+EventBatch::EventBatch(const std::vector<EventPtr>& events)
+  : m_events(events)
+  , m_skipped(events.size(), false)
+  , m_nSkipped(0)
+{
+}
+
+//--------------
+// Destructor --
+//--------------
+EventBatch::~EventBatch()
+{
+}
+
+// Mark event as skipped.
+void
+EventBatch::skip(unsigned i)
+{
+  if (not m_skipped[i]) {
+    m_skipped[i] = true;
+    ++ m_nSkipped;
+  }
+}
+
+// Remove events from the end of the batch.
+void
+EventBatch::truncate(unsigned size)
+{
+  if (size >= m_events.size()) return;
+  for (unsigned i = size; i != m_events.size(); ++ i) {
+    if (m_skipped[i]) -- m_nSkipped;
+  }
+  m_events.resize(size);
+  m_skipped.resize(size);
+}
+
+} // namespace psana
@@ -79,7 +79,7 @@ EventIter::next()
       break;
     } else if (nxt.first == EventLoop::Event) {
       // found event
-      result = nxt.second;
+      result.swap(nxt.second);
       break;
     }
   }
@@ -0,0 +1,106 @@
+//--------------------------------------------------------------------------
+// File and Version Information:
+// 	$Id$
+//
+// Description:
+//	Class EventJoin...
+//
+// Author List:
+//      Andy Salnikov
+//
+//------------------------------------------------------------------------
+
+//-----------------------
+// This Class's Header --
+//-----------------------
+#include "psana/EventJoin.h"
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+#include "PSEvt/EventId.h"
+
+//-----------------------------------------------------------------------
+// Local Macros, Typedefs, Structures, Unions and Forward Declarations --
+//-----------------------------------------------------------------------
+
+//		----------------------------------------
+// 		-- Public Function Member Definitions --
+//		----------------------------------------
+
+namespace psana {
+
+//----------------
+// Constructors --
+//----------------
+EventJoin::EventJoin (const EventIter& iter1, const EventIter& iter2, uint64_t tolerance)
+  : m_iter1(iter1)
+  , m_iter2(iter2)
+  , m_tolerance(tolerance)
+  , m_nUnmatched1(0)
+  , m_nUnmatched2(0)
+{
+}
+
+//--------------
+// Destructor --
+//--------------
+EventJoin::~EventJoin ()
+{
+}
+
+/// get next pair of matching events, returns pair of zero pointers when done
+EventJoin::value_type
+EventJoin::next()
+{
+  value_type result;
+
+  TimedEvent evt1, evt2;
+  bool ok1 = read(m_iter1, evt1, m_nUnmatched1);
+  bool ok2 = ok1 and read(m_iter2, evt2, m_nUnmatched2);
+  while (ok1 and ok2) {
+    const uint64_t diff = evt1.time > evt2.time ? evt1.time - evt2.time : evt2.time - evt1.time;
+    if (evt1.fiducial == evt2.fiducial and diff <= m_tolerance) {
+      result.first.swap(evt1.evt);
+      result.second.swap(evt2.evt);
+      return result;
+    }
+    // drop earlier event
+    if (evt1.time <= evt2.time) {
+      ++ m_nUnmatched1;
+      ok1 = read(m_iter1, evt1, m_nUnmatched1);
+    } else {
+      ++ m_nUnmatched2;
+      ok2 = read(m_iter2, evt2, m_nUnmatched2);
+    }
+  }
+
+  // one of the streams is finished, remaining events of other stream are not read
+  if (ok1) ++ m_nUnmatched1;
+  if (ok2) ++ m_nUnmatched2;
+  return result;
+}
+
+// Read next event which has event id from a stream, returns false at the end
+bool
+EventJoin::read(EventIter& iter, TimedEvent& evt, unsigned long& nDropped)
+{
+  while (boost::shared_ptr<PSEvt::Event> next = iter.next()) {
+    boost::shared_ptr<PSEvt::EventId> eid = next->get();
+    if (not eid) {
+      ++ nDropped;
+      continue;
+    }
+    evt.evt.swap(next);
+    evt.time = uint64_t(eid->time().sec()) * 1000000000ULL + eid->time().nsec();
+    evt.fiducial = eid->fiducials();
+    return true;
+  }
+  return false;
+}
+
+} // namespace psana
@@ -18,15 +18,27 @@
 //-----------------
 // C/C++ Headers --
 //-----------------
+#include <algorithm>
+#include <list>
+#include <set>
+#include <sstream>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
 
 //-------------------------------
 // Collaborating Class Headers --
 //-------------------------------
 #include "MsgLogger/MsgLogger.h"
+#include "psana/Checkpoint.h"
+#include "psana/EventBatch.h"
 #include "psana/Exceptions.h"
 #include "psana/InputIter.h"
 #include "psana/InputModule.h"
-#include "PSEvt/ProxyDict.h"
+#include "psana/ModuleChain.h"
+#include "psana/ModuleProfiler.h"
+#include "psana/ThreadPool.h"
 
 //-----------------------------------------------------------------------
 // Local Macros, Typedefs, Structures, Unions and Forward Declarations --
@@ -42,7 +54,58 @@ namespace {
     // they are the same for now
     return EventLoop::EventType(type);
   }
-  
+
+  // moves first element of the queue into result, swap instead of copy
+  // avoids touching reference count of the event
+  void popFront(std::deque<EventLoop::value_type>& queue, EventLoop::value_type& result)
+  {
+    result.first = queue.front().first;
+    result.second.swap(queue.front().second);
+    queue.pop_front();
+  }
+
+  // names of the event types, used in profiling output
+  const char* eventTypeNames[] = { "BeginJob", "BeginRun", "BeginCalibCycle", "Event",
+                                   "EndCalibCycle", "EndRun", "EndJob" };
+
+  // in multi-threaded mode number of events read in one batch is
+  // this number times number of threads
+  const unsigned batchPerThread = 4;
+
+  // Shared state for processing a batch of events by several module chains
+  struct BatchJob {
+
+    BatchJob(const std::vector<EventLoop::EventPtr>& events, PSEnv::Env& env)
+      : events(events), stats(events.size(), Module::OK), called(events.size(), false)
+      , env(env), next(0), stop(events.size()) {}
+
+    // process events with given chain until no events left, events
+    // following the first stopped event are not started
+    void run(ModuleChain* chain) {
+      while (true) {
+        unsigned i;
+        {
+          boost::lock_guard<boost::mutex> lock(mutex);
+          i = next ++;
+          if (i >= events.size() or i > stop) break;
+          called[i] = true;
+        }
+        Module::Status stat = chain->call(EventLoop::Event, *events[i], env);
+        boost::lock_guard<boost::mutex> lock(mutex);
+        stats[i] = stat;
+        if (stat == Module::Stop or stat == Module::Abort) stop = std::min(stop, i);
+      }
+    }
+
+    const std::vector<EventLoop::EventPtr>& events;
+    std::vector<Module::Status> stats;
+    std::vector<bool> called;   ///< true for events passed to modules
+    PSEnv::Env& env;
+    unsigned next;
+    unsigned stop;              ///< index of first stopped event
+    boost::mutex mutex;
+  };
+
 }
 
 
@@ -59,18 +122,35 @@ EventLoop::EventLoop (const boost::shared_ptr<InputModule>& inputModule,
     const std::vector<boost::shared_ptr<Module> >& modules,
     const boost::shared_ptr<PSEnv::Env>& env)
   : m_inputIter(boost::make_shared<InputIter>(inputModule, env))
-  , m_modules(modules)
+  , m_earlyChain()
+  , m_chain(boost::make_shared<ModuleChain>(modules))
+  , m_copies()
   , m_values()
+  , m_pending()
+  , m_profiler()
+  , m_profileFile()
+  , m_nThreads(1)
+  , m_threadPool()
+  , m_moduleThreads(1)
+  , m_beginThreads(1)
+  , m_batchSize(1)
+  , m_nEarlyRejected(0)
+  , m_timeBudget(false)
+  , m_readAheadDepth(0)
+  , m_liveMaxLag(0)
+  , m_liveDropped(0)
+  , m_chains()
+  , m_mainStopped(false)
+  , m_checkpointFile()
+  , m_checkpointInterval(1)
+  , m_nCalibCycles(0)
+  , m_resumeFile()
+  , m_skipEventKey(true)
+  , m_timeWindow(false)
+  , m_tmin()
+  , m_tmax()
   , m_inputModule(inputModule)
 {
-  m_eventMethods[BeginJob] = &Module::beginJob;
-  m_eventMethods[EndJob] = &Module::endJob;
-  m_eventMethods[BeginRun] = &Module::beginRun;
-  m_eventMethods[EndRun] = &Module::endRun;
-  m_eventMethods[BeginCalibCycle] = &Module::beginCalibCycle;
-  m_eventMethods[EndCalibCycle] = &Module::endCalibCycle;
-  m_eventMethods[Event] = &Module::event;
-  m_eventMethods[None] = 0;
 }
 
 //--------------
@@ -98,29 +178,134 @@ EventLoop::next()
 
   // return first transition in the queue if the queue is not empty
   if (not m_values.empty()) {
-    result = m_values.front();
-    m_values.pop_front();
+    ::popFront(m_values, result);
     return result;
   }
   
   while (true) {
 
     // Get next event from input iterator
-    InputIter::value_type evt = m_inputIter->next();
-    EventType evtType = ::eventType(evt.first);
+    value_type evt = nextInput();
+    EventType evtType = evt.first;
     if (evtType == None) break;
 
+    // copies of the modules must see all transitions
+    if (evtType == BeginJob and m_nThreads > 1) startThreads();
+    if (evtType == BeginJob and m_liveMaxLag > 0 and m_readAheadDepth > 0) {
+      MsgLog(logger, warning, "live catch-up is disabled when read-ahead is enabled");
+    }
+    if (evtType == BeginJob and not m_checkpointFile.empty()) {
+      // input position has to match processed data and all module state
+      // has to be in the modules which are saved
+      const char* reason = 0;
+      if (m_readAheadDepth > 0) {
+        reason = "read-ahead is enabled";
+      } else if (m_inputIter->asyncDepth() > 0 and dynamic_cast<AsyncInputModule*>(m_inputModule.get())) {
+        reason = "asynchronous reads are enabled";
+      } else if (m_threadPool) {
+        reason = "events are processed in multiple threads";
+      }
+      if (reason) {
+        MsgLog(logger, warning, "checkpoints are disabled when " << reason);
+        m_checkpointFile.clear();
+      }
+    }
+    if (evtType == BeginJob and m_timeWindow and
+        (m_readAheadDepth > 0 or (m_inputIter->asyncDepth() > 0 and dynamic_cast<AsyncInputModule*>(m_inputModule.get())))) {
+      throw ExceptionAbort(ERR_LOC, "time window cannot be selected when read-ahead or asynchronous reads are enabled");
+    }
+    if (evtType == BeginJob and not m_resumeFile.empty() and m_threadPool) {
+      throw ExceptionAbort(ERR_LOC, "restart from checkpoint is not supported when events are processed in multiple threads");
+    }
+    if (evtType == BeginJob and m_beginThreads > 1) {
+      // transitions are passed to chains one at a time so they can share the pool
+      boost::shared_ptr<ThreadPool> pool = boost::make_shared<ThreadPool>(m_beginThreads);
+      m_chain->setBeginThreadPool(pool);
+      for (std::vector<boost::shared_ptr<ModuleChain> >::const_iterator it = m_copies.begin(); it != m_copies.end(); ++ it) {
+        (*it)->setBeginThreadPool(pool);
+      }
+    }
+    if (evtType == BeginJob and m_batchSize > 1 and m_inputModule->updatesEnv() and not m_chain->processesBatches()) {
+      // default eventBatch() would call event() with environment of the last event in a batch
+      MsgLog(logger, warning, "input module " << m_inputModule->name()
+          << " updates environment for every event and not all modules process batches, batch mode is disabled");
+      m_batchSize = 1;
+    }
+    if (evtType == BeginJob and m_moduleThreads > 1) {
+      if (m_threadPool) {
+        MsgLog(logger, warning, "concurrent module execution is disabled in multi-threaded mode");
+      } else {
+        m_chain->setThreadPool(boost::make_shared<ThreadPool>(m_moduleThreads));
+      }
+    }
+
+    if (evtType == Event and m_mainStopped) {
+      // regular modules requested stop but other chains still want events
+      if (callChains(Event, *evt.second, false) == Module::Abort) {
+        throw ExceptionAbort(ERR_LOC, "User module requested abort");
+      }
+      continue;
+    }
+
+    if (evtType == Event and m_threadPool) {
+      // regular events are processed in batches
+      processBatch(evt.second);
+      if (not m_values.empty()) {
+        ::popFront(m_values, result);
+        break;
+      }
+      continue;
+    }
+
+    if (evtType == Event and m_batchSize > 1) {
+      // pass events to modules in batches
+      callBatch(evt.second);
+      if (not m_values.empty()) {
+        ::popFront(m_values, result);
+        break;
+      }
+      continue;
+    }
+
     // call corresponding method for all modules
-    Module::Status stat = callModuleMethod(m_eventMethods[evtType], *evt.second, m_inputIter->env(), evtType != Event);
+    Module::Status stat = callModuleMethod(evtType, *evt.second);
+    if (evtType == BeginJob and stat != Module::Abort and not m_resumeFile.empty()) resume();
+    if (evtType == BeginRun and stat != Module::Abort and m_timeWindow) {
+      if (m_inputModule->index().select(m_tmin, m_tmax) != 0) {
+        throw ExceptionAbort(ERR_LOC, "input module " + m_inputModule->name() + " cannot select time window");
+      }
+    }
+    if (evtType == EndCalibCycle and stat != Module::Abort and not m_checkpointFile.empty()) {
+      if (++ m_nCalibCycles >= m_checkpointInterval) {
+        writeCheckpoint();
+        m_nCalibCycles = 0;
+      }
+    }
+    if (evtType == EndRun and m_timeBudget) printOverruns();
+    if (evtType == EndRun and m_liveMaxLag > 0) {
+      MsgLog(logger, info, "dropped " << m_liveDropped << " events in this run to keep up with live data");
+      m_liveDropped = 0;
+    }
+    if (evtType == EndJob) {
+      if (m_profiler) printProfile();
+      printPoolStats();
+      // caches are shared by all copies of the chain
+      m_chain->printCacheStats();
+      if (m_earlyChain) {
+        MsgLog(logger, info, "early filters rejected " << m_nEarlyRejected << " events");
+      }
+    }
     if (stat == Module::Abort) {
       // stop right here
       throw ExceptionAbort(ERR_LOC, "User module requested abort");
     } else if (stat == Module::Stop) {
       // user module requested stop, signal iterator it's time to finish and continue
-      m_inputIter->finish();
+      stopMain();
     } else {
       // good result, return
-      result = value_type(evtType, evt.second);
+      if (stat == Module::Skip and m_skipEventKey) ModuleChain::setSkipped(*evt.second, true);
+      result.first = evtType;
+      result.second.swap(evt.second);
       break;
     }
 
@@ -130,87 +315,550 @@ EventLoop::next()
   
 }
 
+// Add a PSANA module to list of modules
+void
+EventLoop::addmodule(boost::shared_ptr<Module> module)
+{
+  if (not m_copies.empty()) {
+    MsgLog(logger, warning, "module " << module->name() << " added after BeginJob, it will not be copied to other threads");
+  }
+  m_chain->add(module);
+}
+
+// Returns next transition or event from input, modules are not called yet
+EventLoop::value_type
+EventLoop::nextInput()
+{
+  if (not m_pending.empty()) {
+    value_type result;
+    ::popFront(m_pending, result);
+    return result;
+  }
+  while (true) {
+
+    InputIter::value_type evt = m_inputIter->next();
+    value_type result(::eventType(evt.first), EventPtr());
+    result.second.swap(evt.second);
+    if (result.first != Event) return result;
+
+    // in live mode drop events if we are too far behind
+    if (m_liveMaxLag > 0 and m_readAheadDepth == 0 and m_inputModule->liveAvail(m_liveMaxLag)) {
+      ++ m_liveDropped;
+      continue;
+    }
+
+    if (not m_earlyChain) return result;
+
+    // run early filters on partially read event
+    Module::Status stat = m_earlyChain->call(Event, *result.second, m_inputIter->env());
+    if (stat == Module::OK) {
+      m_inputIter->readPayload(*result.second);
+      return result;
+    } else if (stat == Module::Skip) {
+      ++ m_nEarlyRejected;
+    } else if (stat == Module::Stop) {
+      m_inputIter->finish();
+    } else {
+      throw ExceptionAbort(ERR_LOC, "User module requested abort");
+    }
+  }
+}
+
 //
-// Call given method for all defined modules, ignoreSkip should be set
-// to false for event() method, true for everything else
+// Call given method for all defined modules, transitions are passed
+// to all copies of module chain as well
 //
 Module::Status
-EventLoop::callModuleMethod(ModuleMethod method, PSEvt::Event& evt, PSEnv::Env& env, bool ignoreSkip)
+EventLoop::callModuleMethod(EventType evtType, PSEvt::Event& evt)
 {
+  PSEnv::Env& env = m_inputIter->env();
+
+  // early filters see regular events before they are fully read
   Module::Status stat = Module::OK;
+  if (m_earlyChain and evtType != Event) {
+    stat = m_earlyChain->call(evtType, evt, env);
+    if (stat == Module::Abort) return stat;
+  }
 
-  if (ignoreSkip) {
+  // statuses are ordered by severity
+  stat = std::max(stat, m_chain->call(evtType, evt, env));
+  if (evtType != Event) {
+    for (std::vector<boost::shared_ptr<ModuleChain> >::const_iterator it = m_copies.begin(); it != m_copies.end(); ++ it) {
+      if (stat == Module::Abort) break;
+      stat = std::max(stat, (*it)->call(evtType, evt, env));
+    }
+  }
 
-    // call all modules, do not skip any one of them
+  // other chains have their own Skip/Stop state, only abort is propagated
+  if (stat != Module::Abort and not m_chains.empty()) {
+    if (callChains(evtType, evt, stat == Module::Skip) == Module::Abort) stat = Module::Abort;
+  }
+  return stat;
+}
 
-    for (std::vector<boost::shared_ptr<Module> >::const_iterator it = m_modules.begin() ; it != m_modules.end() ; ++it) {
-      boost::shared_ptr<Module> mod = *it;
+// Pass event or transition to additional module chains
+Module::Status
+EventLoop::callChains(EventType evtType, PSEvt::Event& evt, bool skipped)
+{
+  PSEnv::Env& env = m_inputIter->env();
 
-      // clear module status
-      mod->reset();
+  for (std::vector<NamedChain>::iterator it = m_chains.begin(); it != m_chains.end(); ++ it) {
 
-      // call the method
-      ((*mod).*method)(evt, env);
+    // stopped chains still see transitions
+    if (evtType == Event) {
+      if (it->stopped) continue;
+      ModuleChain::setSkipped(evt, false);
+    }
 
-      // check what module wants to tell us
-      if (mod->status() == Module::Skip) {
-        // silently ignore Skip
-      } else if (mod->status() == Module::Stop) {
-        // set the flag but continue
-        MsgLog(logger, info, "module " << mod->name() << " requested stop");
-        stat = Module::Stop;
-      } else if (mod->status() == Module::Abort) {
-        // abort immediately
-        MsgLog(logger, info, "module " << mod->name() << " requested abort");
-        stat = Module::Abort;
-        break;
-      }
+    // data added by this chain is removed after the call so that every
+    // chain sees only input data and products of the regular modules
+    std::list<PSEvt::EventKey> keys;
+    const boost::shared_ptr<PSEvt::ProxyDictI>& dict = evt.proxyDict();
+    dict->keys(keys);
+    const std::set<PSEvt::EventKey> before(keys.begin(), keys.end());
+
+    Module::Status stat = it->chain->call(evtType, evt, env);
+
+    keys.clear();
+    dict->keys(keys);
+    for (std::list<PSEvt::EventKey>::const_iterator kit = keys.begin(); kit != keys.end(); ++ kit) {
+      if (before.count(*kit) == 0) dict->remove(*kit);
     }
 
-  } else {
+    if (stat == Module::Abort) {
+      MsgLog(logger, info, "module chain " << it->name << " requested abort");
+      return stat;
+    } else if (stat == Module::Stop and not it->stopped) {
+      MsgLog(logger, info, "module chain " << it->name << " requested stop");
+      it->stopped = true;
+      if (m_mainStopped and allChainsStopped()) m_inputIter->finish();
+    }
+  }
+
+  // restore skip state of the main chain which is seen by caller
+  if (evtType == Event) ModuleChain::setSkipped(evt, skipped and m_skipEventKey);
+
+  return Module::OK;
+}
+
+// Stop passing events to main chain, finish input if no other chain needs events
+void
+EventLoop::stopMain()
+{
+  m_mainStopped = true;
+  if (allChainsStopped()) m_inputIter->finish();
+}
+
+// Returns true if all additional chains requested stop
+bool
+EventLoop::allChainsStopped() const
+{
+  for (std::vector<NamedChain>::const_iterator it = m_chains.begin(); it != m_chains.end(); ++ it) {
+    if (not it->stopped) return false;
+  }
+  return true;
+}
+
+// Make copies of module chain and start threads
+void
+EventLoop::startThreads()
+{
+  // all events of a batch are read before they are processed
+  if (m_inputModule->updatesEnv()) {
+    MsgLog(logger, warning, "input module " << m_inputModule->name()
+        << " updates environment for every event, multi-threaded mode is disabled");
+    return;
+  }
 
-    // call all modules, respect Skip flag
+  for (unsigned i = 1; i < m_nThreads; ++ i) {
+    boost::shared_ptr<ModuleChain> copy = m_chain->clone();
+    if (not copy) {
+      MsgLog(logger, warning, "cannot copy modules, multi-threaded mode is disabled");
+      m_copies.clear();
+      return;
+    }
+    m_copies.push_back(copy);
+  }
+  m_threadPool = boost::make_shared<ThreadPool>(m_nThreads);
+  MsgLog(logger, info, "processing events in " << m_nThreads << " threads");
+}
+
+// Read more events following the given one and process them in parallel
+void
+EventLoop::processBatch(const EventPtr& first)
+{
+  std::vector<EventPtr> events;
+  readBatch(first, m_nThreads * ::batchPerThread, events);
+
+  // every chain takes next unprocessed event until none left
+  ::BatchJob job(events, m_inputIter->env());
+  std::vector<ThreadPool::Task> tasks;
+  tasks.push_back(boost::bind(&::BatchJob::run, &job, m_chain.get()));
+  for (std::vector<boost::shared_ptr<ModuleChain> >::const_iterator it = m_copies.begin(); it != m_copies.end(); ++ it) {
+    tasks.push_back(boost::bind(&::BatchJob::run, &job, it->get()));
+  }
+  m_threadPool->run(tasks);
+
+  if (job.stop < events.size()) {
+    // other threads may have started events after the stopping one before
+    // they saw the stop, modules have already processed them
+    const unsigned nCalled = std::count(job.called.begin() + job.stop + 1, job.called.end(), true);
+    if (nCalled > 0) {
+      MsgLog(logger, warning, nCalled << " event(s) following the stopped event were already processed"
+          " by other threads, they are not returned");
+    }
+  }
+
+  // return results in original order
+  for (unsigned i = 0; i != events.size(); ++ i) {
+    if (job.stats[i] == Module::Abort) {
+      throw ExceptionAbort(ERR_LOC, "User module requested abort");
+    }
+    if (not m_chains.empty() and callChains(Event, *events[i], job.stats[i] == Module::Skip) == Module::Abort) {
+      throw ExceptionAbort(ERR_LOC, "User module requested abort");
+    }
+    if (m_mainStopped) continue;
+    if (job.stats[i] == Module::Stop) {
+      // events following this one are not returned
+      stopMain();
+      continue;
+    }
+    if (job.stats[i] == Module::Skip and m_skipEventKey) ModuleChain::setSkipped(*events[i], true);
+    m_values.push_back(value_type(Event, EventPtr()));
+    m_values.back().second.swap(events[i]);
+  }
+}
 
-    for (std::vector<boost::shared_ptr<Module> >::const_iterator it = m_modules.begin() ; it != m_modules.end() ; ++it) {
-      boost::shared_ptr<Module> mod = *it;
+// Read more events following the given one and pass them to modules as a batch
+void
+EventLoop::callBatch(const EventPtr& first)
+{
+  std::vector<EventPtr> events;
+  readBatch(first, m_batchSize, events);
 
-      // clear module status
-      mod->reset();
+  EventBatch batch(events);
+  Module::Status stat = m_chain->callBatch(batch, m_inputIter->env());
+  if (stat == Module::Abort) {
+    throw ExceptionAbort(ERR_LOC, "User module requested abort");
+  }
+  for (unsigned i = 0; i != batch.size(); ++ i) {
+    if (batch.skipped(i) and m_skipEventKey) ModuleChain::setSkipped(batch.event(i), true);
+    m_values.push_back(value_type(Event, batch.eventPtr(i)));
+  }
 
-      // call the method, skip regular modules if skip status is set, but
-      // still call special modules which are interested in all events
-      if (stat == Module::OK or mod->observeAllEvents()) {
-        ((*mod).*method)(evt, env);
+  // other chains see every event one by one, including those truncated by main chain
+  if (not m_chains.empty()) {
+    for (unsigned i = 0; i != events.size(); ++ i) {
+      bool skipped = i < batch.size() and batch.skipped(i);
+      if (callChains(Event, *events[i], skipped) == Module::Abort) {
+        throw ExceptionAbort(ERR_LOC, "User module requested abort");
       }
+    }
+  }
 
-      // check what module wants to tell us
-      if (mod->status() == Module::Skip) {
+  if (stat == Module::Stop) {
+    // events after the stopping one were already discarded
+    stopMain();
+  }
+}
 
-        // Set the skip flag but continue as there may be modules interested in every event
-        MsgLog(logger, trace, "module " << mod->name() << " requested skip");
-        if (stat == Module::OK) stat = Module::Skip;
+// Read up to maxSize consecutive regular events starting with the given one
+void
+EventLoop::readBatch(const EventPtr& first, unsigned maxSize, std::vector<EventPtr>& events)
+{
+  events.assign(1, first);
+  while (events.size() < maxSize) {
+    // first transition is saved for later
+    value_type evt = nextInput();
+    if (evt.first != Event) {
+      m_pending.push_back(evt);
+      break;
+    }
+    events.push_back(evt.second);
+  }
+}
 
-        // add special flag to event
-        if (not evt.exists<int>("__psana_skip_event__")) {
-          evt.put(boost::make_shared<int>(1), "__psana_skip_event__");
-        }
+// Returns next transition skipping all regular events before it.
+EventLoop::value_type
+EventLoop::nextTransition()
+{
+  // drop events which were already processed or read
+  while (not m_values.empty() and m_values.front().first == Event) m_values.pop_front();
+  if (m_values.empty()) {
+    while (not m_pending.empty() and m_pending.front().first == Event) m_pending.pop_front();
+    if (m_pending.empty()) m_inputIter->skipEvents();
+  }
+  return next();
+}
 
-      } else if (mod->status() == Module::Stop) {
-        // stop right here
-        MsgLog(logger, info, "module " << mod->name() << " requested stop");
-        stat = Module::Stop;
-        break;
-      } else if (mod->status() == Module::Abort) {
-        // abort immediately
-        MsgLog(logger, info, "module " << mod->name() << " requested abort");
-        stat = Module::Abort;
-        break;
+// Returns next transition or a group of regular events.
+EventLoop::EventType
+EventLoop::nextBatch(std::vector<EventPtr>& events)
+{
+  events.clear();
+  value_type evt = next();
+  if (evt.first == None) return None;
+
+  events.push_back(evt.second);
+  if (evt.first == Event) {
+    while (not m_values.empty() and m_values.front().first == Event) {
+      events.push_back(EventPtr());
+      events.back().swap(m_values.front().second);
+      m_values.pop_front();
+    }
+  }
+  return evt.first;
+}
+
+// Enable collection of timing statistics for user modules.
+void
+EventLoop::enableProfiling(const std::string& dumpFile)
+{
+  std::vector<std::string> names(::eventTypeNames, ::eventTypeNames + sizeof ::eventTypeNames / sizeof ::eventTypeNames[0]);
+  m_profiler = boost::make_shared<ModuleProfiler>(names);
+  m_profileFile = dumpFile;
+  m_chain->setProfiler(m_profiler);
+}
+
+// Read input data in a background thread.
+void
+EventLoop::setReadAhead(unsigned depth)
+{
+  m_inputIter->setReadAhead(depth);
+  m_readAheadDepth = m_inputIter->readAheadDepth();
+}
+
+// Keep several reads in flight for asynchronous input modules.
+void
+EventLoop::setAsyncDepth(unsigned depth)
+{
+  m_inputIter->setAsyncDepth(depth);
+}
+
+// Reuse event objects after they are released.
+void
+EventLoop::setEventPoolSize(unsigned size)
+{
+  m_inputIter->setEventPoolSize(size);
+}
+
+// Set modules which filter events before they are fully read.
+void
+EventLoop::setEarlyFilters(const std::vector<boost::shared_ptr<Module> >& modules)
+{
+  if (modules.empty()) {
+    m_earlyChain.reset();
+  } else {
+    m_earlyChain = boost::make_shared<ModuleChain>(modules);
+  }
+  m_inputIter->setTwoPhase(not modules.empty());
+}
+
+// Add one more independent chain of modules.
+void
+EventLoop::addChain(const std::string& name, const std::vector<boost::shared_ptr<Module> >& modules)
+{
+  for (std::vector<NamedChain>::const_iterator it = m_chains.begin(); it != m_chains.end(); ++ it) {
+    if (it->name == name) throw ExceptionAbort(ERR_LOC, "duplicate module chain name: " + name);
+  }
+
+  // products of the regular modules are seen by every chain, same keys
+  // declared in a chain would fail when added to event
+  std::vector<boost::shared_ptr<Module> > regular(m_chain->modules());
+  if (m_earlyChain) regular.insert(regular.end(), m_earlyChain->modules().begin(), m_earlyChain->modules().end());
+  for (std::vector<boost::shared_ptr<Module> >::const_iterator mit = modules.begin(); mit != modules.end(); ++ mit) {
+    const std::vector<std::string>& produced = (*mit)->producedKeys();
+    for (std::vector<boost::shared_ptr<Module> >::const_iterator rit = regular.begin(); rit != regular.end(); ++ rit) {
+      const std::vector<std::string>& other = (*rit)->producedKeys();
+      for (std::vector<std::string>::const_iterator kit = produced.begin(); kit != produced.end(); ++ kit) {
+        if (std::find(other.begin(), other.end(), *kit) != other.end()) {
+          throw ExceptionAbort(ERR_LOC, "module " + (*mit)->name() + " in chain " + name +
+              " produces key \"" + *kit + "\" which is also produced by regular module " + (*rit)->name());
+        }
       }
     }
+  }
+
+  NamedChain chain;
+  chain.name = name;
+  chain.chain = boost::make_shared<ModuleChain>(modules);
+  chain.stopped = false;
+  m_chains.push_back(chain);
+}
 
+// Cache products of cacheable modules on disk.
+void
+EventLoop::setProductCache(const std::string& dir)
+{
+  m_chain->setProductCache(dir, m_inputIter->env().experiment());
+}
+
+// Periodically save checkpoint which allows restarting the job.
+void
+EventLoop::setCheckpoint(const std::string& path, unsigned interval)
+{
+  m_checkpointFile = path;
+  m_checkpointInterval = std::max(interval, 1U);
+  m_nCalibCycles = 0;
+}
+
+// Read only events in time window of every run.
+void
+EventLoop::setTimeWindow(const EventTime& tmin, const EventTime& tmax)
+{
+  m_timeWindow = true;
+  m_tmin = tmin;
+  m_tmax = tmax;
+}
+
+// Set time budgets for processing of regular events.
+void
+EventLoop::setTimeBudget(double moduleBudget, double eventBudget)
+{
+  // convert milliseconds to nanoseconds
+  m_chain->setTimeBudget(uint64_t(std::max(moduleBudget, 0.) * 1e6), uint64_t(std::max(eventBudget, 0.) * 1e6));
+  m_timeBudget = moduleBudget > 0 or eventBudget > 0;
+}
+
+// Save input position and module state to checkpoint file
+void
+EventLoop::writeCheckpoint()
+{
+  Checkpoint ckpt;
+  if (not m_inputModule->resumePosition(ckpt.run, ckpt.filenames, ckpt.offsets, ckpt.lastBeginCalibCycleDgram)) {
+    MsgLog(logger, warning, "input module " << m_inputModule->name() << " cannot report its position, checkpoints are disabled");
+    m_checkpointFile.clear();
+    return;
   }
 
-  return stat;
+  const std::vector<NamedModule> modules = checkpointModules();
+  for (std::vector<NamedModule>::const_iterator it = modules.begin(); it != modules.end(); ++ it) {
+    std::ostringstream out;
+    it->second->saveCheckpoint(out);
+    ckpt.moduleStates[it->first] = out.str();
+  }
+
+  ckpt.write(m_checkpointFile);
+  MsgLog(logger, trace, "checkpoint saved to " << m_checkpointFile);
+}
+
+// Restore module state and input position from checkpoint file
+void
+EventLoop::resume()
+{
+  // resume only once
+  std::string path;
+  path.swap(m_resumeFile);
+
+  Checkpoint ckpt;
+  if (not ckpt.read(path)) {
+    MsgLog(logger, info, "checkpoint file " << path << " does not exist, starting from the beginning");
+    return;
+  }
+
+  const std::vector<NamedModule> modules = checkpointModules();
+  for (std::vector<NamedModule>::const_iterator it = modules.begin(); it != modules.end(); ++ it) {
+    std::map<std::string, std::string>::const_iterator state = ckpt.moduleStates.find(it->first);
+    if (state == ckpt.moduleStates.end()) {
+      MsgLog(logger, warning, "checkpoint has no state for module " << it->first);
+      continue;
+    }
+    std::istringstream in(state->second);
+    it->second->loadCheckpoint(in);
+  }
+
+  RandomAccess& rax = m_inputModule->randomAccess();
+  rax.setrun(ckpt.run);
+  if (rax.jump(ckpt.filenames, ckpt.offsets, ckpt.lastBeginCalibCycleDgram, 0, 0) != 0) {
+    throw ExceptionAbort(ERR_LOC, "failed to resume from checkpoint " + path);
+  }
+  MsgLog(logger, info, "resumed run " << ckpt.run << " from checkpoint " << path);
+}
+
+// Returns all modules whose state is saved in checkpoint
+std::vector<EventLoop::NamedModule>
+EventLoop::checkpointModules() const
+{
+  // regular modules are keyed by their names, others by chain and module
+  // name as the same module may appear in several chains
+  std::vector<NamedModule> modules;
+  if (m_earlyChain) {
+    const std::vector<boost::shared_ptr<Module> >& chain = m_earlyChain->modules();
+    for (std::vector<boost::shared_ptr<Module> >::const_iterator it = chain.begin(); it != chain.end(); ++ it) {
+      modules.push_back(NamedModule("early-filters:" + (*it)->name(), *it));
+    }
+  }
+  const std::vector<boost::shared_ptr<Module> >& chain = m_chain->modules();
+  for (std::vector<boost::shared_ptr<Module> >::const_iterator it = chain.begin(); it != chain.end(); ++ it) {
+    modules.push_back(NamedModule((*it)->name(), *it));
+  }
+  for (std::vector<NamedChain>::const_iterator cit = m_chains.begin(); cit != m_chains.end(); ++ cit) {
+    const std::vector<boost::shared_ptr<Module> >& chain = cit->chain->modules();
+    for (std::vector<boost::shared_ptr<Module> >::const_iterator it = chain.begin(); it != chain.end(); ++ it) {
+      modules.push_back(NamedModule(cit->name + ":" + (*it)->name(), *it));
+    }
+  }
+  return modules;
+}
+
+// Print and reset time budget overruns
+void
+EventLoop::printOverruns()
+{
+  // sum counters from all copies of the chain
+  std::vector<unsigned long> modOverruns = m_chain->moduleOverruns();
+  unsigned long evtOverruns = m_chain->eventOverruns();
+  m_chain->resetOverruns();
+  for (std::vector<boost::shared_ptr<ModuleChain> >::const_iterator it = m_copies.begin(); it != m_copies.end(); ++ it) {
+    const std::vector<unsigned long>& counts = (*it)->moduleOverruns();
+    for (unsigned i = 0; i != counts.size() and i != modOverruns.size(); ++ i) modOverruns[i] += counts[i];
+    evtOverruns += (*it)->eventOverruns();
+    (*it)->resetOverruns();
+  }
+
+  WithMsgLog(logger, info, out) {
+    out << "time budget overruns in this run: " << evtOverruns << " events over event budget";
+    const std::vector<boost::shared_ptr<Module> >& modules = m_chain->modules();
+    for (unsigned i = 0; i != modOverruns.size(); ++ i) {
+      if (modOverruns[i] > 0) out << "\n  module " << modules[i]->name() << ": " << modOverruns[i];
+    }
+  }
+}
+
+// Print event pool statistics
+void
+EventLoop::printPoolStats() const
+{
+  const EventPool& pool = m_inputIter->eventPool();
+  if (pool.maxSize() > 0) {
+    WithMsgLog(logger, info, out) {
+      pool.print(out);
+    }
+  }
+}
+
+// Print/save profiling results
+void
+EventLoop::printProfile() const
+{
+  std::vector<std::string> names;
+  const std::vector<boost::shared_ptr<Module> >& modules = m_chain->modules();
+  for (std::vector<boost::shared_ptr<Module> >::const_iterator it = modules.begin() ; it != modules.end() ; ++it) {
+    names.push_back((*it)->name());
+  }
+
+  WithMsgLog(logger, info, out) {
+    out << "Module timing summary:\n";
+    m_profiler->print(out, names);
+  }
+
+  if (not m_profileFile.empty()) {
+    if (m_profiler->dump(m_profileFile, names)) {
+      MsgLog(logger, info, "module timing summary saved to " << m_profileFile);
+    } else {
+      MsgLog(logger, warning, "failed to save module timing summary to " << m_profileFile);
+    }
+  }
 }
 
 Index& EventLoop::index()
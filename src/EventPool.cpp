@@ -0,0 +1,193 @@
+//--------------------------------------------------------------------------
+// File and Version Information:
+//     $Id$
+//
+// Description:
+//     Class EventPool...
+//
+// Author List:
+//     Andy Salnikov
+//
+//------------------------------------------------------------------------
+
+//-----------------------
+// This Class's Header --
+//-----------------------
+#include "psana/EventPool.h"
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+#include <list>
+#include <iostream>
+#include <boost/make_shared.hpp>
+#include <boost/thread/locks.hpp>
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+#include "PSEvt/ProxyDict.h"
+
+//-----------------------------------------------------------------------
+// Local Macros, Typedefs, Structures, Unions and Forward Declarations --
+//-----------------------------------------------------------------------
+
+//             ----------------------------------------
+//             -- Public Function Member Definitions --
+//             ----------------------------------------
+
+namespace psana {
+
+//----------------
+// Constructors --
+//----------------
+EventPool::EventPool(const boost::shared_ptr<PSEvt::AliasMap>& aliasMap, unsigned maxSize)
+  : m_aliasMap(aliasMap)
+  , m_maxSize(maxSize)
+  , m_free()
+  , m_nCreated(0)
+  , m_nReused(0)
+  , m_nDeleted(0)
+  , m_maxFree(0)
+  , m_mutex()
+{
+}
+
+//--------------
+// Destructor --
+//--------------
+EventPool::~EventPool()
+{
+  for (std::vector<PSEvt::Event*>::iterator it = m_free.begin(); it != m_free.end(); ++ it) {
+    delete *it;
+  }
+}
+
+// Change maximum number of released events kept in the pool
+void
+EventPool::setMaxSize(unsigned maxSize)
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  m_maxSize = maxSize;
+  while (m_free.size() > m_maxSize) {
+    delete m_free.back();
+    m_free.pop_back();
+  }
+}
+
+// Returns maximum number of released events kept in the pool
+unsigned
+EventPool::maxSize() const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  return m_maxSize;
+}
+
+// Returns new empty event, it is taken from the pool if possible
+EventPool::EventPtr
+EventPool::get()
+{
+  PSEvt::Event* evt = 0;
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    if (m_maxSize == 0) {
+      // no pooling, same as regular event
+      ++ m_nCreated;
+      return boost::make_shared<PSEvt::Event>(boost::make_shared<PSEvt::ProxyDict>(m_aliasMap));
+    }
+    if (not m_free.empty()) {
+      evt = m_free.back();
+      m_free.pop_back();
+      ++ m_nReused;
+    } else {
+      ++ m_nCreated;
+    }
+  }
+
+  if (not evt) evt = new PSEvt::Event(boost::make_shared<PSEvt::ProxyDict>(m_aliasMap));
+  return EventPtr(evt, Recycler(shared_from_this()));
+}
+
+// Print pool statistics
+void
+EventPool::print(std::ostream& out) const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  out << "event pool: max size=" << m_maxSize << " created=" << m_nCreated
+      << " reused=" << m_nReused << " deleted=" << m_nDeleted
+      << " max free=" << m_maxFree << " free now=" << m_free.size();
+}
+
+// Returns number of events created by this pool
+unsigned long
+EventPool::nCreated() const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  return m_nCreated;
+}
+
+// Returns number of events which were taken from the pool
+unsigned long
+EventPool::nReused() const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  return m_nReused;
+}
+
+// Returns number of released events currently in the pool
+unsigned
+EventPool::size() const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  return m_free.size();
+}
+
+// clear event and return it to the pool or delete it
+void
+EventPool::recycle(PSEvt::Event* evt)
+{
+  bool keep = false;
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    keep = m_free.size() < m_maxSize;
+  }
+
+  if (keep) {
+    // remove everything from event dictionary, this is done without lock;
+    // if something cannot be removed then event is not reused
+    const boost::shared_ptr<PSEvt::ProxyDictI>& dict = evt->proxyDict();
+    std::list<PSEvt::EventKey> keys;
+    dict->keys(keys);
+    for (std::list<PSEvt::EventKey>::const_iterator it = keys.begin(); it != keys.end(); ++ it) {
+      if (not dict->remove(*it)) keep = false;
+    }
+  }
+
+  if (keep) {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    if (m_free.size() < m_maxSize) {
+      m_free.push_back(evt);
+      if (m_free.size() > m_maxFree) m_maxFree = m_free.size();
+      return;
+    }
+  }
+
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    ++ m_nDeleted;
+  }
+  delete evt;
+}
+
+// deleter for events created by pool
+void
+EventPool::Recycler::operator()(PSEvt::Event* evt) const
+{
+  if (boost::shared_ptr<EventPool> thePool = pool.lock()) {
+    thePool->recycle(evt);
+  } else {
+    delete evt;
+  }
+}
+
+} // namespace psana
@@ -0,0 +1,178 @@
+//--------------------------------------------------------------------------
+// File and Version Information:
+//     $Id$
+//
+// Description:
+//     Class EventTimeArray...
+//
+// Author List:
+//     Andy Salnikov
+//
+//------------------------------------------------------------------------
+
+//-----------------------
+// This Class's Header --
+//-----------------------
+#include "psana/EventTimeArray.h"
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+
+//-----------------------------------------------------------------------
+// Local Macros, Typedefs, Structures, Unions and Forward Declarations --
+//-----------------------------------------------------------------------
+
+namespace {
+
+  // binary search stops when range is smaller than this, rest is scanned
+  const size_t scanSize = 32;
+
+  const uint64_t nsPerSec = 1000000000ULL;
+
+  // number of bits set and position of lowest set bit in 4-bit mask
+  const unsigned bitCount[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+  const unsigned firstBit[16] = { 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0 };
+
+  uint64_t toNs(uint32_t sec, uint32_t nsec) { return sec * nsPerSec + nsec; }
+
+  uint64_t absDiff(uint64_t a, uint64_t b) { return a > b ? a - b : b - a; }
+
+  // Count times in [0, n) which are less than (s, ns)
+  size_t countLess(const uint32_t* sec, const uint32_t* nsec, size_t n, uint32_t s, uint32_t ns)
+  {
+    size_t count = 0;
+    size_t i = 0;
+#ifdef __SSE2__
+    // SSE2 only has signed comparison, flip sign bit to compare unsigned values
+    const __m128i bias = _mm_set1_epi32(0x80000000);
+    const __m128i vs = _mm_xor_si128(_mm_set1_epi32(s), bias);
+    const __m128i vns = _mm_xor_si128(_mm_set1_epi32(ns), bias);
+    for ( ; i + 4 <= n; i += 4) {
+      const __m128i a = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(sec + i)), bias);
+      const __m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(nsec + i)), bias);
+      const __m128i less = _mm_or_si128(_mm_cmplt_epi32(a, vs),
+          _mm_and_si128(_mm_cmpeq_epi32(a, vs), _mm_cmplt_epi32(b, vns)));
+      count += ::bitCount[_mm_movemask_ps(_mm_castsi128_ps(less))];
+    }
+#endif
+    for ( ; i != n; ++ i) {
+      if (sec[i] < s or (sec[i] == s and nsec[i] < ns)) ++ count;
+    }
+    return count;
+  }
+
+  // Returns index of first value in [0, n) equal to f, n if not found
+  size_t findValue(const uint32_t* data, size_t n, uint32_t f)
+  {
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i vf = _mm_set1_epi32(f);
+    for ( ; i + 4 <= n; i += 4) {
+      const __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(data + i)), vf);
+      const int mask = _mm_movemask_ps(_mm_castsi128_ps(eq));
+      if (mask) return i + ::firstBit[mask];
+    }
+#endif
+    for ( ; i != n; ++ i) {
+      if (data[i] == f) return i;
+    }
+    return n;
+  }
+
+}
+
+//             ----------------------------------------
+//             -- Public Function Member Definitions --
+//             ----------------------------------------
+
+namespace psana {
+
+const size_t EventTimeArray::npos;
+
+// Returns index of the first time which is not less than given, fiducial is ignored
+size_t
+EventTimeArray::lowerBound(const EventTime& time) const
+{
+  return lowerBound(time.seconds(), time.nanoseconds(), 0, size());
+}
+
+// Returns index of time which has the same time and fiducial, npos if not found
+size_t
+EventTimeArray::find(const EventTime& time) const
+{
+  const size_t n = size();
+  for (size_t i = lowerBound(time); i != n and m_sec[i] == time.seconds() and m_nsec[i] == time.nanoseconds(); ++ i) {
+    if (m_fid[i] == time.fiducial()) return i;
+  }
+  return npos;
+}
+
+// Find time closest to given one with the same fiducial.
+size_t
+EventTimeArray::findNearest(const EventTime& time, uint64_t tolerance) const
+{
+  const uint64_t t = ::toNs(time.seconds(), time.nanoseconds());
+  const uint64_t t0 = t > tolerance ? t - tolerance : 0;
+  const uint64_t t1 = t + tolerance + 1;
+
+  // window of candidates [begin, end)
+  const size_t begin = lowerBound(t0 / ::nsPerSec, t0 % ::nsPerSec, 0, size());
+  const size_t end = lowerBound(t1 / ::nsPerSec, t1 % ::nsPerSec, begin, size());
+
+  size_t best = npos;
+  uint64_t bestDiff = 0;
+  for (size_t i = begin; i < end; ++ i) {
+    i += ::findValue(&m_fid[i], end - i, time.fiducial());
+    if (i == end) break;
+    const uint64_t diff = ::absDiff(::toNs(m_sec[i], m_nsec[i]), t);
+    if (best == npos or diff < bestDiff) {
+      best = i;
+      bestDiff = diff;
+    }
+  }
+  return best;
+}
+
+// Match times of this array with times of another array.
+size_t
+EventTimeArray::match(const EventTimeArray& other, uint64_t tolerance,
+    std::vector<std::pair<size_t, size_t> >& matches) const
+{
+  size_t count = 0;
+  const size_t n = size();
+  for (size_t i = 0; i != n; ++ i) {
+    const size_t j = other.findNearest((*this)[i], tolerance);
+    if (j != npos) {
+      matches.push_back(std::make_pair(i, j));
+      ++ count;
+    }
+  }
+  return count;
+}
+
+// Returns index of first time not less than given time in [begin, end)
+size_t
+EventTimeArray::lowerBound(uint32_t sec, uint32_t nsec, size_t begin, size_t end) const
+{
+  // binary search until range is small, then count with SIMD
+  while (end - begin > ::scanSize) {
+    const size_t mid = begin + (end - begin) / 2;
+    if (m_sec[mid] < sec or (m_sec[mid] == sec and m_nsec[mid] < nsec)) {
+      begin = mid + 1;
+    } else {
+      end = mid;
+    }
+  }
+  if (begin == end) return begin;
+  return begin + ::countLess(&m_sec[begin], &m_nsec[begin], end - begin, sec, nsec);
+}
+
+} // namespace psana
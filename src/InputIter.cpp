@@ -28,7 +28,7 @@
 #include "MsgLogger/MsgLogger.h"
 #include "psana/Exceptions.h"
 #include "psana/InputModule.h"
-#include "PSEvt/ProxyDict.h"
+#include "psana/InputReadAhead.h"
 
 //-----------------------------------------------------------------------
 // Local Macros, Typedefs, Structures, Unions and Forward Declarations --
@@ -38,6 +38,15 @@ namespace {
 
   const char* logger = "InputIter";
 
+  // moves first element of the queue into result, swap instead of copy
+  // avoids touching reference count of the event
+  void popFront(std::deque<InputIter::value_type>& queue, InputIter::value_type& result)
+  {
+    result.first = queue.front().first;
+    result.second.swap(queue.front().second);
+    queue.pop_front();
+  }
+
 }
 
 //		----------------------------------------
@@ -52,11 +61,18 @@ namespace psana {
 InputIter::InputIter (const boost::shared_ptr<InputModule>& inputModule,
     const boost::shared_ptr<PSEnv::Env>& env)
   : m_inputModule(inputModule)
+  , m_asyncModule(dynamic_cast<AsyncInputModule*>(inputModule.get()))
+  , m_asyncDepth(0)
   , m_env(env)
   , m_finished(false)
   , m_state(StateNone)
   , m_values()
   , m_aliasMap(env->aliasMap())
+  , m_eventPool(boost::make_shared<EventPool>(m_aliasMap, 0))
+  , m_readAheadDepth(0)
+  , m_twoPhase(false)
+  , m_skipping(false)
+  , m_readAhead()
 {
   m_newStateEventType[StateNone] = None;
   m_newStateEventType[StateConfigured] = BeginJob;
@@ -69,7 +85,7 @@ InputIter::InputIter (const boost::shared_ptr<InputModule>& inputModule,
   m_closeStateEventType[StateScanning] = EndCalibCycle;
 
   // run beginJob for input module
-  EventPtr evt = boost::make_shared<PSEvt::Event>(boost::make_shared<PSEvt::ProxyDict>(m_aliasMap));
+  EventPtr evt = m_eventPool->get();
   m_inputModule->beginJob(*evt, *m_env);
   newState(StateConfigured, evt);
 }
@@ -79,9 +95,11 @@ InputIter::InputIter (const boost::shared_ptr<InputModule>& inputModule,
 //--------------
 InputIter::~InputIter ()
 {
+  stopReadAhead();
+
   // call endJob if has not been called yet
   if (m_state != StateNone) {
-    EventPtr evt = boost::make_shared<PSEvt::Event>(boost::make_shared<PSEvt::ProxyDict>(m_aliasMap));
+    EventPtr evt = m_eventPool->get();
     m_inputModule->endJob(*evt, *m_env);
   }
 }
@@ -97,8 +115,7 @@ InputIter::next()
   
   // if queue is not empty return first transition in the queue
   if (not m_values.empty()) {
-    result = m_values.front();
-    m_values.pop_front();
+    ::popFront(m_values, result);
     return result;
   }
 
@@ -118,11 +135,9 @@ InputIter::next()
   // transition from input module, decide what to do with it
   while (m_values.empty()) {
 
-    // Create event object
-    EventPtr evt = boost::make_shared<PSEvt::Event>(boost::make_shared<PSEvt::ProxyDict>(m_aliasMap));
-
     // run input module to populate event
-    InputModule::Status istat = m_inputModule->event(*evt, *m_env);
+    EventPtr evt;
+    InputModule::Status istat = readInput(evt);
     MsgLog(logger, debug, "input.event() returned " << istat);
 
     // check input status
@@ -133,12 +148,22 @@ InputIter::next()
       throw ExceptionAbort(ERR_LOC, "Input module requested abort");
     }
 
+    // regular events are not needed until next transition, but event
+    // outside of calib cycle starts one implicitly which ends skipping;
+    // such event was read by eventHeader() only and is completed here
+    if (istat == InputModule::DoEvent and m_skipping) {
+      if (m_state == StateScanning) continue;
+      if (not m_twoPhase and not m_readAhead) m_inputModule->eventPayload(*evt, *m_env);
+    }
+    m_skipping = false;
+
     // dispatch event to particular method based on event type
     if (istat == InputModule::DoEvent) {
 
       // Make sure that Begin called for all states
       this->newState(StateScanning, evt);
-      m_values.push_back(value_type(Event, evt));
+      m_values.push_back(value_type(Event, EventPtr()));
+      m_values.back().second.swap(evt);
 
     } else {
 
@@ -166,7 +191,8 @@ InputIter::next()
 
   if (m_values.empty()) {
     // means we reached the end, time to call endJob
-    EventPtr evt = boost::make_shared<PSEvt::Event>(boost::make_shared<PSEvt::ProxyDict>(m_aliasMap));
+    stopReadAhead();
+    EventPtr evt = m_eventPool->get();
     m_inputModule->endJob(*evt, *m_env);
     unwind(StateNone, evt);
     m_finished = true;
@@ -174,8 +200,7 @@ InputIter::next()
 
   // return first transition in the queue
   if (not m_values.empty()) {
-    result = m_values.front();
-    m_values.pop_front();
+    ::popFront(m_values, result);
   }
 
   WithMsgLog(logger, debug, out) {
@@ -191,18 +216,108 @@ InputIter::next()
   return result;
 }
 
+// Enable reading of input data in a separate thread.
+void
+InputIter::setReadAhead(unsigned depth)
+{
+  if (depth > 0 and m_inputModule->updatesEnv()) {
+    MsgLog(logger, warning, "input module " << m_inputModule->name()
+        << " updates environment for every event, read-ahead is disabled");
+    depth = 0;
+  }
+  m_readAheadDepth = depth;
+}
 
 void
 InputIter::finish()
 {
   // means we reached the end, time to call endJob
-  EventPtr evt = boost::make_shared<PSEvt::Event>(boost::make_shared<PSEvt::ProxyDict>(m_aliasMap));
+  stopReadAhead();
+  EventPtr evt = m_eventPool->get();
   m_inputModule->endJob(*evt, *m_env);
   unwind(StateNone, evt);
   m_finished = true;
 }
 
 
+// Get next event and its status from input module or read-ahead queue
+InputModule::Status
+InputIter::readInput(EventPtr& evt)
+{
+  if (m_readAheadDepth == 0) {
+    evt = m_eventPool->get();
+    if (m_asyncModule and m_asyncModule->outstanding() < m_asyncDepth) {
+      // keep the queue of reads full
+      m_asyncModule->submit(m_asyncDepth - m_asyncModule->outstanding());
+    }
+    if (m_twoPhase or m_skipping) {
+      // transitions are always needed in full, only regular events are split
+      InputModule::Status istat = m_inputModule->eventHeader(*evt, *m_env);
+      if (istat != InputModule::DoEvent and istat != InputModule::Skip and
+          istat != InputModule::Stop and istat != InputModule::Abort) {
+        m_inputModule->eventPayload(*evt, *m_env);
+      }
+      return istat;
+    }
+    return m_inputModule->event(*evt, *m_env);
+  }
+
+  // start reading thread on first call
+  if (not m_readAhead) {
+    m_readAhead = boost::make_shared<InputReadAhead>(m_inputModule, m_env, m_eventPool, m_readAheadDepth);
+  }
+
+  InputReadAhead::value_type val = m_readAhead->next();
+  if (val.first == InputModule::Abort and not m_readAhead->error().empty()) {
+    throw ExceptionAbort(ERR_LOC, "Input module failed: " + m_readAhead->error());
+  }
+  evt = val.second;
+  return val.first;
+}
+
+// Skip regular events up to the next transition.
+void
+InputIter::skipEvents()
+{
+  // transitions which are already queued are kept
+  std::deque<value_type> values;
+  for (std::deque<value_type>::const_iterator it = m_values.begin(); it != m_values.end(); ++ it) {
+    if (it->first != Event) values.push_back(*it);
+  }
+  m_values.swap(values);
+
+  // skipping ends at the next transition, if one is already queued then
+  // events following it belong to other step and must not be skipped
+  if (m_finished or not m_values.empty()) return;
+
+  // read-ahead thread may have read some events already, they are discarded in next()
+  if (m_readAhead or not m_inputModule->skipToTransition(*m_env)) {
+    m_skipping = true;
+  }
+}
+
+// Read remaining data for the regular event returned from next().
+void
+InputIter::readPayload(PSEvt::Event& evt)
+{
+  // events from read-ahead thread are complete
+  if (m_twoPhase and not m_readAhead) {
+    m_inputModule->eventPayload(evt, *m_env);
+  }
+}
+
+// Stop read-ahead thread if it is running
+void
+InputIter::stopReadAhead()
+{
+  if (m_readAhead) {
+    m_readAhead->stop();
+    m_readAhead.reset();
+    // do not restart it after finish
+    m_readAheadDepth = 0;
+  }
+}
+
 void
 InputIter::newState(State state, const EventPtr& evt)
 {
@@ -211,7 +326,7 @@ InputIter::newState(State state, const EventPtr& evt)
   // make sure that previous state is also in the stack
   if (int(m_state) < int(state-1)) {
     // use different event instance for it
-    EventPtr evt = boost::make_shared<PSEvt::Event>(boost::make_shared<PSEvt::ProxyDict>(m_aliasMap));
+    EventPtr evt = m_eventPool->get();
     newState(State(state-1), evt);
   }
 
@@ -247,7 +362,7 @@ InputIter::unwind(State newState, const EventPtr& evt)
 {
   while (m_state > newState+1) {
     // use different event instance for it
-    EventPtr evt = boost::make_shared<PSEvt::Event>(boost::make_shared<PSEvt::ProxyDict>(m_aliasMap));
+    EventPtr evt = m_eventPool->get();
     closeState(evt);
   }
   if (m_state > newState) {
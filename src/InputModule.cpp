@@ -49,6 +49,41 @@ InputModule::~InputModule ()
 {
 }
 
+// Method which reads light part of the next event.
+InputModule::Status
+InputModule::eventHeader(Event& evt, Env& env)
+{
+  return event(evt, env);
+}
+
+// Method which reads remaining data for an accepted event.
+void
+InputModule::eventPayload(Event& evt, Env& env)
+{
+}
+
+// Skip regular events up to the next transition.
+bool
+InputModule::skipToTransition(Env& env)
+{
+  return false;
+}
+
+// Returns true if event() may update environment.
+bool
+InputModule::updatesEnv() const
+{
+  return true;
+}
+
+// Returns current input position for restarting the job.
+bool
+InputModule::resumePosition(int& run, std::vector<std::string>& filenames,
+    std::vector<int64_t>& offsets, std::string& lastBeginCalibCycleDgram)
+{
+  return false;
+}
+
 Index& InputModule::index() {
   throw ExceptionAbort(ERR_LOC, "Index not supported by this input module");
 }
@@ -57,6 +92,40 @@ RandomAccess& InputModule::randomAccess() {
   throw ExceptionAbort(ERR_LOC, "RandomAccess not supported by this input module");
 }
 
+//----------------
+// Constructors --
+//----------------
+AsyncInputModule::AsyncInputModule(const std::string& name)
+  : InputModule(name)
+  , m_outstanding(0)
+{
+}
+
+//--------------
+// Destructor --
+//--------------
+AsyncInputModule::~AsyncInputModule()
+{
+}
+
+// Submit reads of up to nEvents following events.
+unsigned
+AsyncInputModule::submit(unsigned nEvents)
+{
+  unsigned n = doSubmit(nEvents);
+  m_outstanding += n;
+  return n;
+}
+
+// Completes oldest outstanding read.
+InputModule::Status
+AsyncInputModule::event(Event& evt, Env& env)
+{
+  if (m_outstanding == 0 and submit(1) == 0) return Stop;
+  -- m_outstanding;
+  return doComplete(evt, env);
+}
+
 // formatting for enum
 std::ostream&
 operator<<(std::ostream& out, InputModule::Status stat)
@@ -0,0 +1,153 @@
+//--------------------------------------------------------------------------
+// File and Version Information:
+//     $Id$
+//
+// Description:
+//     Class InputReadAhead...
+//
+// Author List:
+//     Andy Salnikov
+//
+//------------------------------------------------------------------------
+
+//-----------------------
+// This Class's Header --
+//-----------------------
+#include "psana/InputReadAhead.h"
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+#include <exception>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+#include "MsgLogger/MsgLogger.h"
+
+//-----------------------------------------------------------------------
+// Local Macros, Typedefs, Structures, Unions and Forward Declarations --
+//-----------------------------------------------------------------------
+
+namespace {
+
+  const char* logger = "InputReadAhead";
+
+}
+
+//             ----------------------------------------
+//             -- Public Function Member Definitions --
+//             ----------------------------------------
+
+namespace psana {
+
+//----------------
+// Constructors --
+//----------------
+InputReadAhead::InputReadAhead(const boost::shared_ptr<InputModule>& inputModule,
+    const boost::shared_ptr<PSEnv::Env>& env,
+    const boost::shared_ptr<EventPool>& eventPool,
+    unsigned depth)
+  : m_inputModule(inputModule)
+  , m_env(env)
+  , m_eventPool(eventPool)
+  , m_depth(depth > 0 ? depth : 1)
+  , m_queue()
+  , m_stop(false)
+  , m_done(false)
+  , m_error()
+  , m_mutex()
+  , m_notFull()
+  , m_notEmpty()
+  , m_thread(boost::bind(&InputReadAhead::run, this))
+{
+  MsgLog(logger, debug, "started read-ahead thread, depth=" << m_depth);
+}
+
+//--------------
+// Destructor --
+//--------------
+InputReadAhead::~InputReadAhead()
+{
+  stop();
+}
+
+// Returns next status and event from the queue, waits if queue is empty.
+InputReadAhead::value_type
+InputReadAhead::next()
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  while (m_queue.empty() and not m_done) {
+    m_notEmpty.wait(lock);
+  }
+
+  if (m_queue.empty()) {
+    return value_type(InputModule::Stop, EventPtr());
+  }
+
+  // swap instead of copy to avoid touching reference count
+  value_type result(m_queue.front().first, EventPtr());
+  result.second.swap(m_queue.front().second);
+  m_queue.pop_front();
+  m_notFull.notify_one();
+  return result;
+}
+
+// Stop reading thread and discard all events in the queue.
+void
+InputReadAhead::stop()
+{
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_stop = true;
+    m_queue.clear();
+    m_notFull.notify_all();
+  }
+  if (m_thread.joinable()) m_thread.join();
+}
+
+// body of the reading thread
+void
+InputReadAhead::run()
+{
+  while (true) {
+
+    {
+      boost::unique_lock<boost::mutex> lock(m_mutex);
+      while (m_queue.size() >= m_depth and not m_stop) {
+        m_notFull.wait(lock);
+      }
+      if (m_stop) break;
+    }
+
+    // read next event without holding the lock
+    EventPtr evt = m_eventPool->get();
+    InputModule::Status istat;
+    std::string error;
+    try {
+      istat = m_inputModule->event(*evt, *m_env);
+    } catch (const std::exception& ex) {
+      istat = InputModule::Abort;
+      error = ex.what();
+    } catch (...) {
+      istat = InputModule::Abort;
+      error = "unknown exception";
+    }
+
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    if (m_stop) break;
+    if (not error.empty()) m_error = error;
+    m_queue.push_back(value_type(istat, EventPtr()));
+    m_queue.back().second.swap(evt);
+    m_notEmpty.notify_one();
+    if (istat == InputModule::Stop or istat == InputModule::Abort) break;
+  }
+
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  m_done = true;
+  m_notEmpty.notify_all();
+}
+
+} // namespace psana
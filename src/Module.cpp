@@ -18,15 +18,34 @@
 //-----------------
 // C/C++ Headers --
 //-----------------
+#include <list>
 
 //-------------------------------
 // Collaborating Class Headers --
 //-------------------------------
+#include "ConfigSvc/ConfigSvc.h"
 
 //-----------------------------------------------------------------------
 // Local Macros, Typedefs, Structures, Unions and Forward Declarations --
 //-----------------------------------------------------------------------
 
+namespace {
+
+  // FNV-1a hash, stable between runs and platforms
+  uint64_t fnvHash(uint64_t hash, const std::string& str)
+  {
+    for (std::string::const_iterator it = str.begin(); it != str.end(); ++ it) {
+      hash ^= (unsigned char)*it;
+      hash *= 1099511628211ULL;
+    }
+    // separator so that "ab","c" and "a","bc" differ
+    hash ^= 0xff;
+    hash *= 1099511628211ULL;
+    return hash;
+  }
+
+}
+
 //		----------------------------------------
 // 		-- Public Function Member Definitions --
 //		----------------------------------------
@@ -40,6 +59,11 @@ Module::Module (const std::string& name, bool observeAllEvents)
   : Configurable(name)
   , m_status(OK)
   , m_observeAllEvents(observeAllEvents)
+  , m_eventSkipped(false)
+  , m_consumes()
+  , m_produces()
+  , m_cacheable(false)
+  , m_mayFilter(false)
 {
 }
 
@@ -68,6 +92,29 @@ Module::beginCalibCycle(Event& evt, Env& env)
 {
 }
 
+// Method which is called with a batch of events in batch mode
+void
+Module::eventBatch(EventBatch& batch, Env& env)
+{
+  for (unsigned i = 0; i != batch.size(); ++ i) {
+
+    const bool skipped = batch.skipped(i);
+    if (skipped and not m_observeAllEvents) continue;
+
+    reset(skipped);
+    event(batch.event(i), env);
+
+    if (m_status == Skip) {
+      batch.skip(i);
+      m_status = OK;
+    } else if (m_status == Stop or m_status == Abort) {
+      // this and following events will not be seen by anybody
+      batch.truncate(i);
+      return;
+    }
+  }
+}
+
 // Method which is called at the end of the calibration cycle
 void 
 Module::endCalibCycle(Event& evt, Env& env)
@@ -87,6 +134,64 @@ Module::endJob(Event& evt, Env& env)
 }
 
 
+// Make a copy of this module for multi-threaded event processing.
+Module*
+Module::clone() const
+{
+  return 0;
+}
+
+// Save data which event() added to the event.
+void
+Module::saveProducts(Event& evt, std::ostream& out) const
+{
+}
+
+// Restore data saved by saveProducts().
+void
+Module::loadProducts(Event& evt, std::istream& in)
+{
+}
+
+// Save module state for a checkpoint.
+void
+Module::saveCheckpoint(std::ostream& out) const
+{
+}
+
+// Restore module state saved by saveCheckpoint().
+void
+Module::loadCheckpoint(std::istream& in)
+{
+}
+
+// Returns hash of module configuration.
+uint64_t
+Module::configHash() const
+{
+  ConfigSvc::ConfigSvc cfg = configSvc();
+  uint64_t hash = 14695981039346656037ULL;
+
+  // parameters may come from class section too
+  std::vector<std::string> sections(1, className());
+  if (name() != className()) sections.push_back(name());
+  for (std::vector<std::string>::const_iterator sect = sections.begin(); sect != sections.end(); ++ sect) {
+    std::list<std::string> keys;
+    try {
+      keys = cfg.getKeys(*sect);
+    } catch (const ConfigSvc::ExceptionMissing& ex) {
+      continue;
+    }
+    keys.sort();
+    hash = ::fnvHash(hash, *sect);
+    for (std::list<std::string>::const_iterator key = keys.begin(); key != keys.end(); ++ key) {
+      hash = ::fnvHash(hash, *key);
+      hash = ::fnvHash(hash, cfg.getStr(*sect, *key));
+    }
+  }
+  return hash;
+}
+
 // formatting for enum
 std::ostream&
 operator<<(std::ostream& out, Module::Status stat)
@@ -0,0 +1,786 @@
+//--------------------------------------------------------------------------
+// File and Version Information:
+//     $Id$
+//
+// Description:
+//     Class ModuleChain...
+//
+// Author List:
+//     Andy Salnikov
+//
+//------------------------------------------------------------------------
+
+//-----------------------
+// This Class's Header --
+//-----------------------
+#include "psana/ModuleChain.h"
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+#include <time.h>
+#include <algorithm>
+#include <sstream>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/ref.hpp>
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+#include "MsgLogger/MsgLogger.h"
+#include "psana/Exceptions.h"
+#include "psana/ModuleProfiler.h"
+#include "psana/ProductCache.h"
+#include "psana/ThreadPool.h"
+
+//-----------------------------------------------------------------------
+// Local Macros, Typedefs, Structures, Unions and Forward Declarations --
+//-----------------------------------------------------------------------
+
+namespace {
+
+  const char* logger = "ModuleChain";
+
+  typedef void (Module::*ModuleMethod)(PSEvt::Event& evt, PSEnv::Env& env);
+
+  // methods to call for each event type, in the order of EventLoop::EventType
+  const ModuleMethod eventMethods[] = {
+    &Module::beginJob,
+    &Module::beginRun,
+    &Module::beginCalibCycle,
+    &Module::event,
+    &Module::endCalibCycle,
+    &Module::endRun,
+    &Module::endJob,
+  };
+
+  // names of the methods, used in messages
+  const char* eventMethodNames[] = { "beginJob", "beginRun", "beginCalibCycle", "event",
+                                     "endCalibCycle", "endRun", "endJob" };
+
+  // number of event types in EventLoop::EventType, not counting None
+  const unsigned NumEventTypes = sizeof eventMethods / sizeof eventMethods[0];
+
+#if defined(__GNUC__) && not defined(__clang__)
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpmf-conversions"
+
+  // Module which does not override anything, gives default implementations
+  class DefaultModule : public Module {
+  public:
+    DefaultModule() : Module("psana.DefaultModule") {}
+    virtual void event(Event& evt, Env& env) {}
+  };
+
+  // Returns true if module overrides given method. This relies on GCC
+  // extension which converts bound pointer to member into function address.
+  bool overrides(Module& mod, ModuleMethod method)
+  {
+    static DefaultModule defModule;
+    return (void*)(mod.*method) != (void*)(defModule.*method);
+  }
+
+  // Returns true if module overrides eventBatch() method.
+  bool overridesBatch(Module& mod)
+  {
+    static DefaultModule defModule;
+    void (Module::*method)(EventBatch& batch, Env& env) = &Module::eventBatch;
+    return (void*)(mod.*method) != (void*)(defModule.*method);
+  }
+
+#pragma GCC diagnostic pop
+
+#else
+
+  // no portable way to check it, assume all methods are overridden
+  bool overrides(Module& mod, ModuleMethod method)
+  {
+    return true;
+  }
+
+  // batch mode is only safe for modules which process batches themselves,
+  // assume that none of them does
+  bool overridesBatch(Module& mod)
+  {
+    return false;
+  }
+
+#endif
+
+  // current wall clock time in nanoseconds
+  uint64_t wallClock()
+  {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+  }
+
+  // value stored in event for skipped events, shared by all events
+  const boost::shared_ptr<int> skipFlag = boost::make_shared<int>(1);
+
+  // returns true if two lists have at least one common element
+  bool intersect(const std::vector<std::string>& l1, const std::vector<std::string>& l2)
+  {
+    for (std::vector<std::string>::const_iterator it = l1.begin(); it != l1.end(); ++ it) {
+      if (std::find(l2.begin(), l2.end(), *it) != l2.end()) return true;
+    }
+    return false;
+  }
+
+  // returns true if module must run after preceding module
+  bool depends(const Module& mod, const Module& prev)
+  {
+    // modules which do not declare anything depend on everything, filters
+    // too as following modules are not called for events that they skip
+    if (not mod.declaresDependencies() or not prev.declaresDependencies()) return true;
+    if (mod.mayFilter() or prev.mayFilter()) return true;
+    return intersect(mod.consumedKeys(), prev.producedKeys()) or
+        intersect(mod.producedKeys(), prev.producedKeys()) or
+        intersect(mod.producedKeys(), prev.consumedKeys());
+  }
+
+}
+
+//             ----------------------------------------
+//             -- Public Function Member Definitions --
+//             ----------------------------------------
+
+namespace psana {
+
+//----------------
+// Constructors --
+//----------------
+ModuleChain::ModuleChain(const std::vector<boost::shared_ptr<Module> >& modules)
+  : m_modules(modules)
+  , m_profiler()
+  , m_threadPool()
+  , m_schedule()
+  , m_dispatch(::NumEventTypes)
+  , m_beginThreadPool()
+  , m_transitionSchedule(::NumEventTypes)
+  , m_moduleBudget(0)
+  , m_eventBudget(0)
+  , m_elapsed()
+  , m_moduleOverruns()
+  , m_eventOverruns(0)
+  , m_caches(modules.size())
+{
+  resetOverruns();
+  makeDispatch();
+}
+
+//--------------
+// Destructor --
+//--------------
+ModuleChain::~ModuleChain()
+{
+}
+
+// Add one more module at the end of the chain
+void
+ModuleChain::add(const boost::shared_ptr<Module>& module)
+{
+  m_modules.push_back(module);
+  m_elapsed.resize(m_modules.size(), 0);
+  m_moduleOverruns.resize(m_modules.size(), 0);
+  m_caches.resize(m_modules.size());
+  makeDispatch();
+  if (not m_schedule.empty()) makeSchedule();
+  if (m_beginThreadPool) makeTransitionSchedule();
+}
+
+// Set time budgets for regular events.
+void
+ModuleChain::setTimeBudget(uint64_t moduleBudget, uint64_t eventBudget)
+{
+  m_moduleBudget = moduleBudget;
+  m_eventBudget = eventBudget;
+  resetOverruns();
+}
+
+// Reset overrun counters
+void
+ModuleChain::resetOverruns()
+{
+  m_elapsed.assign(m_modules.size(), 0);
+  m_moduleOverruns.assign(m_modules.size(), 0);
+  m_eventOverruns = 0;
+}
+
+// Enable product cache for cacheable modules.
+void
+ModuleChain::setProductCache(const std::string& dir, const std::string& experiment)
+{
+  m_caches.assign(m_modules.size(), boost::shared_ptr<ProductCache>());
+  if (dir.empty()) return;
+  for (unsigned i = 0; i != m_modules.size(); ++ i) {
+    if (m_modules[i]->cacheable()) {
+      m_caches[i] = boost::make_shared<ProductCache>(dir, boost::cref(*m_modules[i]), experiment);
+      MsgLog(logger, info, "products of module " << m_modules[i]->name() << " will be cached in " << m_caches[i]->path());
+    }
+  }
+  if (not m_schedule.empty()) makeSchedule();
+}
+
+// Print statistics of product caches.
+void
+ModuleChain::printCacheStats() const
+{
+  for (unsigned i = 0; i != m_caches.size(); ++ i) {
+    if (m_caches[i]) {
+      MsgLog(logger, info, "product cache for module " << m_modules[i]->name() << ": "
+          << m_caches[i]->nHits() << " hits, " << m_caches[i]->nMisses() << " misses");
+    }
+  }
+}
+
+// Set thread pool used to run independent modules concurrently.
+void
+ModuleChain::setThreadPool(const boost::shared_ptr<ThreadPool>& threadPool)
+{
+  m_threadPool = threadPool;
+  m_schedule.clear();
+}
+
+// Set thread pool used to run begin transitions concurrently.
+void
+ModuleChain::setBeginThreadPool(const boost::shared_ptr<ThreadPool>& threadPool)
+{
+  m_beginThreadPool = threadPool;
+  makeTransitionSchedule();
+}
+
+//
+// Call given method for all defined modules, Skip is only respected
+// for regular events
+//
+Module::Status
+ModuleChain::call(EventLoop::EventType evtType, PSEvt::Event& evt, PSEnv::Env& env)
+{
+  Module::Status stat = Module::OK;
+
+  if (evtType != EventLoop::Event and not m_transitionSchedule[evtType].empty()) {
+
+    // call independent modules in parallel
+    stat = callTransitionScheduled(evtType, evt, env);
+
+  } else if (evtType != EventLoop::Event) {
+
+    // call all modules which implement this method, do not skip any one of them
+
+    const std::vector<DispatchEntry>& dispatch = m_dispatch[evtType];
+    for (std::vector<DispatchEntry>::const_iterator it = dispatch.begin(); it != dispatch.end(); ++ it) {
+
+      Module* mod = it->second;
+
+      // clear module status
+      mod->reset();
+
+      // call the method
+      callModule(it->first, evtType, evt, env);
+
+      // check what module wants to tell us
+      if (mod->status() == Module::Skip) {
+        // silently ignore Skip
+      } else if (mod->status() == Module::Stop) {
+        // set the flag but continue
+        MsgLog(logger, info, "module " << mod->name() << " requested stop");
+        stat = Module::Stop;
+      } else if (mod->status() == Module::Abort) {
+        // abort immediately
+        MsgLog(logger, info, "module " << mod->name() << " requested abort");
+        stat = Module::Abort;
+        break;
+      }
+    }
+
+    if (evtType == EventLoop::BeginJob) {
+      makeSchedule();
+      makeTransitionSchedule();
+    }
+
+  } else if (not m_schedule.empty()) {
+
+    // call modules in parallel
+    stat = callScheduled(evt, env);
+
+  } else {
+
+    // call all modules, respect Skip flag
+
+    const bool budget = m_moduleBudget > 0 or m_eventBudget > 0;
+    const uint64_t eventStart = budget ? ::wallClock() : 0;
+    bool eventOverrun = false;
+    bool flagged = false;
+
+    for (unsigned i = 0; i != m_modules.size(); ++ i) {
+
+      Module* mod = m_modules[i].get();
+
+      // clear module status
+      mod->reset(stat != Module::OK);
+
+      // call the method, skip regular modules if skip status is set, but
+      // still call special modules which are interested in all events
+      bool called = false;
+      if (stat == Module::OK) {
+        callModule(i, evtType, evt, env);
+        called = true;
+      } else if (mod->observeAllEvents()) {
+        // special flag is only added for modules which may still look for it
+        if (not flagged) setSkipped(evt, true);
+        flagged = true;
+        callModule(i, evtType, evt, env);
+        called = true;
+      }
+
+      // check what module wants to tell us
+      updateStatus(*mod, stat);
+      if (stat == Module::Stop or stat == Module::Abort) break;
+
+      if (budget and called) checkBudget(i, eventStart, eventOverrun, stat);
+    }
+
+  }
+
+  return stat;
+}
+
+// Call eventBatch() method for all modules.
+Module::Status
+ModuleChain::callBatch(EventBatch& batch, PSEnv::Env& env)
+{
+  Module::Status stat = Module::OK;
+
+  for (unsigned i = 0; i != m_modules.size() and batch.size() > 0; ++ i) {
+
+    Module* mod = m_modules[i].get();
+
+    // clear module status
+    mod->reset();
+
+    // modules which are not interested in skipped events do not need to be called
+    if (batch.nSkipped() == batch.size() and not mod->observeAllEvents()) continue;
+
+    // special flag is only added for modules which may still look for it
+    if (mod->observeAllEvents() and batch.nSkipped() > 0) {
+      for (unsigned j = 0; j != batch.size(); ++ j) {
+        if (batch.skipped(j)) setSkipped(batch.event(j), true);
+      }
+    }
+
+    if (m_profiler) {
+      ModuleProfiler::Stamp start = ModuleProfiler::now();
+      mod->eventBatch(batch, env);
+      m_profiler->record(i, EventLoop::Event, start);
+    } else {
+      mod->eventBatch(batch, env);
+    }
+
+    // check what module wants to tell us
+    if (mod->status() == Module::Skip) {
+      MsgLog(logger, trace, "module " << mod->name() << " requested skip of the batch");
+      for (unsigned j = 0; j != batch.size(); ++ j) batch.skip(j);
+    } else if (mod->status() == Module::Stop) {
+      // continue with events that were processed before stop
+      MsgLog(logger, info, "module " << mod->name() << " requested stop");
+      stat = Module::Stop;
+    } else if (mod->status() == Module::Abort) {
+      // abort immediately
+      MsgLog(logger, info, "module " << mod->name() << " requested abort");
+      stat = Module::Abort;
+      break;
+    }
+  }
+
+  return stat;
+}
+
+// Returns true if every module overrides Module::eventBatch().
+bool
+ModuleChain::processesBatches() const
+{
+  for (std::vector<boost::shared_ptr<Module> >::const_iterator it = m_modules.begin(); it != m_modules.end(); ++ it) {
+    if (not ::overridesBatch(**it)) return false;
+  }
+  return true;
+}
+
+// Make a copy of this chain for use in a different thread.
+boost::shared_ptr<ModuleChain>
+ModuleChain::clone() const
+{
+  boost::shared_ptr<ModuleChain> chain = boost::make_shared<ModuleChain>(std::vector<boost::shared_ptr<Module> >());
+  for (std::vector<boost::shared_ptr<Module> >::const_iterator it = m_modules.begin() ; it != m_modules.end() ; ++it) {
+    if (Module* copy = (*it)->clone()) {
+      chain->m_modules.push_back(boost::shared_ptr<Module>(copy));
+    } else {
+      MsgLog(logger, warning, "module " << (*it)->name() << " does not support cloning");
+      return boost::shared_ptr<ModuleChain>();
+    }
+  }
+  chain->m_profiler = m_profiler;
+  chain->setTimeBudget(m_moduleBudget, m_eventBudget);
+  chain->m_caches = m_caches;
+  chain->makeDispatch();
+  return chain;
+}
+
+// Calls event() method for all modules according to schedule.
+Module::Status
+ModuleChain::callScheduled(PSEvt::Event& evt, PSEnv::Env& env)
+{
+  Module::Status stat = Module::OK;
+
+  const bool budget = m_moduleBudget > 0 or m_eventBudget > 0;
+  const uint64_t eventStart = budget ? ::wallClock() : 0;
+  bool eventOverrun = false;
+
+  std::vector<ThreadPool::Task> tasks;
+  std::vector<unsigned> called;
+  bool flagged = false;
+  for (std::vector<std::vector<unsigned> >::const_iterator step = m_schedule.begin(); step != m_schedule.end(); ++ step) {
+
+    // after skip only call modules which are interested in all events
+    tasks.clear();
+    called.clear();
+    for (std::vector<unsigned>::const_iterator it = step->begin(); it != step->end(); ++ it) {
+      Module* mod = m_modules[*it].get();
+      mod->reset(stat != Module::OK);
+      if (stat != Module::OK and mod->observeAllEvents() and not flagged) {
+        setSkipped(evt, true);
+        flagged = true;
+      }
+      if (stat == Module::OK or mod->observeAllEvents()) {
+        tasks.push_back(boost::bind(&ModuleChain::callModule, this, *it, EventLoop::Event, boost::ref(evt), boost::ref(env)));
+        called.push_back(*it);
+      }
+    }
+    if (tasks.size() == 1) {
+      tasks.front()();
+    } else if (not tasks.empty()) {
+      // modules in parallel steps do not produce anything, event store is
+      // not protected against concurrent updates; this only detects the
+      // violation after the fact, it does not prevent the race
+      const size_t nKeys = evt.keys().size();
+      m_threadPool->run(tasks);
+      if (evt.keys().size() != nKeys) {
+        throw ExceptionAbort(ERR_LOC, "module running in parallel with other modules added data to event,"
+            " all data added to event must be declared with produces()");
+      }
+    }
+
+    // statuses are checked in the order of modules, in sequential mode
+    // modules following one which requested skip or stop would not be called
+    for (unsigned i = 0; i != called.size(); ++ i) {
+      const Module& mod = *m_modules[called[i]];
+      if (tasks.size() > 1 and (mod.status() == Module::Skip or mod.status() == Module::Stop)) {
+        for (unsigned j = i + 1; j != called.size(); ++ j) {
+          const Module& next = *m_modules[called[j]];
+          if (mod.status() == Module::Stop or not next.observeAllEvents()) {
+            std::ostringstream str;
+            str << "module " << mod.name() << " requested " << mod.status() << " while module "
+                << next.name() << " was running in parallel with it, modules which declare"
+                " their data and may filter events must call setMayFilter()";
+            throw ExceptionAbort(ERR_LOC, str.str());
+          }
+        }
+      }
+      updateStatus(mod, stat);
+    }
+    if (stat == Module::Stop or stat == Module::Abort) break;
+
+    if (budget) {
+      for (std::vector<unsigned>::const_iterator it = called.begin(); it != called.end(); ++ it) {
+        checkBudget(*it, eventStart, eventOverrun, stat);
+      }
+    }
+  }
+
+  return stat;
+}
+
+// Calls transition method for all modules according to transition schedule.
+Module::Status
+ModuleChain::callTransitionScheduled(EventLoop::EventType evtType, PSEvt::Event& evt, PSEnv::Env& env)
+{
+  Module::Status stat = Module::OK;
+
+  std::vector<ThreadPool::Task> tasks;
+  const std::vector<std::vector<DispatchEntry> >& schedule = m_transitionSchedule[evtType];
+  for (std::vector<std::vector<DispatchEntry> >::const_iterator step = schedule.begin(); step != schedule.end(); ++ step) {
+
+    tasks.clear();
+    for (std::vector<DispatchEntry>::const_iterator it = step->begin(); it != step->end(); ++ it) {
+      it->second->reset();
+      tasks.push_back(boost::bind(&ModuleChain::callModule, this, it->first, evtType, boost::ref(evt), boost::ref(env)));
+    }
+    if (tasks.size() == 1) {
+      tasks.front()();
+    } else {
+      // modules in parallel steps do not produce anything, neither event
+      // nor environment stores are protected against concurrent updates;
+      // this only detects the violation after the fact
+      const size_t nKeys = evt.keys().size();
+      const size_t nCalib = env.calibStore().keys().size();
+      const size_t nConfig = env.configStore().keys().size();
+      m_beginThreadPool->run(tasks);
+      if (evt.keys().size() != nKeys or env.calibStore().keys().size() != nCalib or
+          env.configStore().keys().size() != nConfig) {
+        throw ExceptionAbort(ERR_LOC, "module running in parallel with other modules added data to event"
+            " or environment in " + std::string(::eventMethodNames[evtType]) +
+            ", all such data must be declared with produces()");
+      }
+    }
+
+    // statuses are checked in the order of modules, Skip is ignored
+    for (std::vector<DispatchEntry>::const_iterator it = step->begin(); it != step->end(); ++ it) {
+      Module* mod = it->second;
+      if (mod->status() == Module::Stop) {
+        MsgLog(logger, info, "module " << mod->name() << " requested stop");
+        if (stat != Module::Abort) stat = Module::Stop;
+      } else if (mod->status() == Module::Abort) {
+        MsgLog(logger, info, "module " << mod->name() << " requested abort");
+        stat = Module::Abort;
+      }
+    }
+    if (stat == Module::Abort) break;
+  }
+
+  return stat;
+}
+
+// Merges status of the module which processed regular event into summary status.
+void
+ModuleChain::updateStatus(const Module& mod, Module::Status& stat)
+{
+  if (mod.status() == Module::Skip) {
+
+    // Set the skip flag but continue as there may be modules interested in every event
+    MsgLog(logger, trace, "module " << mod.name() << " requested skip");
+    skipEvent(stat);
+
+  } else if (mod.status() == Module::Stop) {
+    // stop right here
+    MsgLog(logger, info, "module " << mod.name() << " requested stop");
+    if (stat != Module::Abort) stat = Module::Stop;
+  } else if (mod.status() == Module::Abort) {
+    // abort immediately
+    MsgLog(logger, info, "module " << mod.name() << " requested abort");
+    stat = Module::Abort;
+  }
+}
+
+// Check time budgets after module was called.
+void
+ModuleChain::checkBudget(unsigned index, uint64_t eventStart, bool& eventOverrun, Module::Status& stat)
+{
+  bool overrun = false;
+  if (m_moduleBudget > 0 and m_elapsed[index] > m_moduleBudget) {
+    ++ m_moduleOverruns[index];
+    overrun = true;
+  }
+  if (m_eventBudget > 0 and not eventOverrun and ::wallClock() - eventStart > m_eventBudget) {
+    ++ m_eventOverruns;
+    eventOverrun = true;
+    overrun = true;
+  }
+  if (overrun) {
+    MsgLog(logger, trace, "module " << m_modules[index]->name() << " exceeded time budget");
+    skipEvent(stat);
+  }
+}
+
+// Marks event as skipped if it was not skipped yet.
+void
+ModuleChain::skipEvent(Module::Status& stat)
+{
+  // skip state is only kept in the status, event is not updated
+  if (stat == Module::OK) stat = Module::Skip;
+}
+
+// Set or clear the flag which marks event as skipped.
+void
+ModuleChain::setSkipped(PSEvt::Event& evt, bool skipped)
+{
+  if (skipped) {
+    if (not evt.exists<int>("__psana_skip_event__")) evt.put(::skipFlag, "__psana_skip_event__");
+  } else {
+    evt.remove<int>("__psana_skip_event__");
+  }
+}
+
+// Build lists of modules for every transition.
+void
+ModuleChain::makeDispatch()
+{
+  for (unsigned evtType = 0; evtType != ::NumEventTypes; ++ evtType) {
+    std::vector<DispatchEntry>& dispatch = m_dispatch[evtType];
+    dispatch.clear();
+    for (unsigned i = 0; i != m_modules.size(); ++ i) {
+      Module* mod = m_modules[i].get();
+      if (::overrides(*mod, ::eventMethods[evtType])) dispatch.push_back(DispatchEntry(i, mod));
+    }
+  }
+}
+
+// Build schedule from module declarations.
+void
+ModuleChain::makeSchedule()
+{
+  m_schedule.clear();
+  if (not m_threadPool) return;
+
+  const unsigned nModules = m_modules.size();
+  std::vector<unsigned> levels;
+  const unsigned nLevels = moduleLevels(levels);
+
+  // modules on the same level are independent, but producers need
+  // exclusive access to event so they run one at a time; modules with
+  // product cache add restored products to event and are producers too
+  bool parallel = false;
+  for (unsigned level = 0; level != nLevels; ++ level) {
+    std::vector<unsigned> consumers;
+    for (unsigned i = 0; i != nModules; ++ i) {
+      if (levels[i] != level) continue;
+      if (m_modules[i]->producedKeys().empty() and not m_caches[i]) {
+        consumers.push_back(i);
+      } else {
+        m_schedule.push_back(std::vector<unsigned>(1, i));
+      }
+    }
+    if (not consumers.empty()) {
+      if (consumers.size() > 1) parallel = true;
+      m_schedule.push_back(consumers);
+    }
+  }
+
+  if (not parallel) {
+    // no reason to use threads
+    MsgLog(logger, info, "no independent modules found, modules will be called sequentially");
+    m_schedule.clear();
+    return;
+  }
+
+  WithMsgLog(logger, info, out) {
+    out << "module schedule:";
+    for (std::vector<std::vector<unsigned> >::const_iterator step = m_schedule.begin(); step != m_schedule.end(); ++ step) {
+      out << " [";
+      for (std::vector<unsigned>::const_iterator it = step->begin(); it != step->end(); ++ it) {
+        if (it != step->begin()) out << ' ';
+        out << m_modules[*it]->name();
+      }
+      out << ']';
+    }
+  }
+}
+
+// Build schedules for begin transitions from module declarations.
+void
+ModuleChain::makeTransitionSchedule()
+{
+  for (unsigned evtType = 0; evtType != ::NumEventTypes; ++ evtType) {
+    m_transitionSchedule[evtType].clear();
+  }
+  if (not m_beginThreadPool) return;
+
+  std::vector<unsigned> levels;
+  const unsigned nLevels = moduleLevels(levels);
+
+  // only modules which implement the method are scheduled; producers may add
+  // data to transition event or to environment stores (e.g. calibrations in
+  // beginRun) which are not protected against concurrent updates, so like
+  // in makeSchedule() they run one at a time and only modules on the same
+  // level which produce nothing run in parallel
+  const EventLoop::EventType evtTypes[] = { EventLoop::BeginRun, EventLoop::BeginCalibCycle };
+  for (unsigned i = 0; i != sizeof evtTypes / sizeof evtTypes[0]; ++ i) {
+
+    const std::vector<DispatchEntry>& dispatch = m_dispatch[evtTypes[i]];
+    std::vector<std::vector<DispatchEntry> > schedule;
+    bool parallel = false;
+    for (unsigned level = 0; level != nLevels; ++ level) {
+      std::vector<DispatchEntry> step;
+      for (std::vector<DispatchEntry>::const_iterator it = dispatch.begin(); it != dispatch.end(); ++ it) {
+        if (levels[it->first] != level) continue;
+        if (m_modules[it->first]->producedKeys().empty() and not m_caches[it->first]) {
+          step.push_back(*it);
+        } else {
+          schedule.push_back(std::vector<DispatchEntry>(1, *it));
+        }
+      }
+      if (step.size() > 1) parallel = true;
+      if (not step.empty()) schedule.push_back(step);
+    }
+
+    // sequential call is cheaper if nothing runs in parallel
+    if (parallel) {
+      MsgLog(logger, info, "method " << ::eventMethodNames[evtTypes[i]] << " will be called for independent modules in parallel");
+      m_transitionSchedule[evtTypes[i]].swap(schedule);
+    }
+  }
+}
+
+// Find level of every module in dependency graph, returns number of levels.
+unsigned
+ModuleChain::moduleLevels(std::vector<unsigned>& levels) const
+{
+  // level of the module in the dependency graph is one more than
+  // the highest level of modules that it depends on
+  const unsigned nModules = m_modules.size();
+  levels.assign(nModules, 0);
+  unsigned nLevels = 0;
+  for (unsigned i = 0; i != nModules; ++ i) {
+    for (unsigned j = 0; j != i; ++ j) {
+      if (::depends(*m_modules[i], *m_modules[j])) levels[i] = std::max(levels[i], levels[j] + 1);
+    }
+    nLevels = std::max(nLevels, levels[i] + 1);
+  }
+  return nLevels;
+}
+
+// Calls a method for one module, measures its time if profiling is enabled.
+void
+ModuleChain::callModule(unsigned index, EventLoop::EventType evtType, PSEvt::Event& evt, PSEnv::Env& env)
+{
+  Module& mod = *m_modules[index];
+  ModuleMethod method = ::eventMethods[evtType];
+
+  // products of cacheable module may be restored from cache instead of calling event()
+  ProductCache* cache = evtType == EventLoop::Event ? m_caches[index].get() : 0;
+  ProductCache::Key key;
+  if (cache and not ProductCache::makeKey(evt, key)) cache = 0;
+  if (cache) {
+    Module::Status status;
+    std::string data;
+    if (cache->find(key, status, data)) {
+      std::istringstream in(data);
+      mod.loadProducts(evt, in);
+      mod.m_status = status;
+      if (m_moduleBudget > 0) m_elapsed[index] = 0;
+      return;
+    }
+  }
+
+  if (m_profiler) {
+    ModuleProfiler::Stamp start = ModuleProfiler::now();
+    (mod.*method)(evt, env);
+    m_profiler->record(index, evtType, start);
+    if (m_moduleBudget > 0 and evtType == EventLoop::Event) m_elapsed[index] = ModuleProfiler::now().wall - start.wall;
+  } else if (m_moduleBudget > 0 and evtType == EventLoop::Event) {
+    const uint64_t start = ::wallClock();
+    (mod.*method)(evt, env);
+    m_elapsed[index] = ::wallClock() - start;
+  } else {
+    (mod.*method)(evt, env);
+  }
+
+  if (cache and (mod.status() == Module::OK or mod.status() == Module::Skip)) {
+    std::ostringstream out;
+    mod.saveProducts(evt, out);
+    cache->store(key, mod.status(), out.str());
+  }
+}
+
+} // namespace psana
@@ -0,0 +1,247 @@
+//--------------------------------------------------------------------------
+// File and Version Information:
+//     $Id$
+//
+// Description:
+//     Class ModuleProfiler...
+//
+// Author List:
+//     Andy Salnikov
+//
+//------------------------------------------------------------------------
+
+//-----------------------
+// This Class's Header --
+//-----------------------
+#include "psana/ModuleProfiler.h"
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+#include <time.h>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <boost/thread/locks.hpp>
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+
+//-----------------------------------------------------------------------
+// Local Macros, Typedefs, Structures, Unions and Forward Declarations --
+//-----------------------------------------------------------------------
+
+namespace {
+
+  // Histogram has 8 bins per factor of 2, values below 8ns go to separate
+  // bins. This gives ~10% resolution for percentiles over full 64-bit range.
+  const unsigned SubBits = 3;
+  const unsigned SubBins = 1U << SubBits;
+  const unsigned NumBins = SubBins + (64 - SubBits) * SubBins;
+
+  uint64_t nsec(const timespec& ts)
+  {
+    return uint64_t(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+  }
+
+  // index of the most significant bit, val must be non-zero
+  unsigned msb(uint64_t val)
+  {
+    return 63 - __builtin_clzll(val);
+  }
+
+  // find histogram bin for a value
+  unsigned bin(uint64_t val)
+  {
+    if (val < SubBins) return val;
+    unsigned e = msb(val);
+    unsigned mant = (val >> (e - SubBits)) & (SubBins - 1);
+    return SubBins + (e - SubBits) * SubBins + mant;
+  }
+
+  // lower edge of the bin
+  uint64_t binLow(unsigned b)
+  {
+    if (b < SubBins) return b;
+    unsigned e = (b - SubBins) / SubBins + SubBits;
+    uint64_t mant = (b - SubBins) % SubBins;
+    return (SubBins + mant) << (e - SubBits);
+  }
+
+  // width of the bin
+  uint64_t binWidth(unsigned b)
+  {
+    if (b < SubBins) return 1;
+    unsigned e = (b - SubBins) / SubBins + SubBits;
+    return uint64_t(1) << (e - SubBits);
+  }
+
+  // convert nanoseconds to milliseconds
+  double ms(double ns) { return ns / 1e6; }
+
+}
+
+//             ----------------------------------------
+//             -- Public Function Member Definitions --
+//             ----------------------------------------
+
+namespace psana {
+
+//----------------
+// Constructors --
+//----------------
+ModuleProfiler::ModuleProfiler(const std::vector<std::string>& transitions)
+  : m_transitions(transitions)
+  , m_stats()
+{
+}
+
+//--------------
+// Destructor --
+//--------------
+ModuleProfiler::~ModuleProfiler()
+{
+}
+
+// Returns current wall-clock and thread CPU time
+ModuleProfiler::Stamp
+ModuleProfiler::now()
+{
+  Stamp stamp;
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  stamp.wall = nsec(ts);
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  stamp.cpu = nsec(ts);
+  return stamp;
+}
+
+// Record the time of one call.
+void
+ModuleProfiler::record(unsigned module, unsigned transition, const Stamp& start)
+{
+  const Stamp stop = now();
+  const uint64_t wall = stop.wall - start.wall;
+  const uint64_t cpu = stop.cpu - start.cpu;
+
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+
+  if (module >= m_stats.size()) m_stats.resize(module+1, std::vector<Stats>(m_transitions.size()));
+  Stats& stats = m_stats[module][transition];
+
+  if (stats.calls == 0) {
+    stats.hist.resize(NumBins, 0);
+    stats.wallMin = wall;
+    stats.wallMax = wall;
+  } else {
+    if (wall < stats.wallMin) stats.wallMin = wall;
+    if (wall > stats.wallMax) stats.wallMax = wall;
+  }
+  ++ stats.calls;
+  stats.wallSum += wall;
+  stats.cpuSum += cpu;
+  ++ stats.hist[bin(wall)];
+}
+
+// Print the table with all collected statistics.
+void
+ModuleProfiler::print(std::ostream& out, const std::vector<std::string>& modules) const
+{
+  format(out, modules, false);
+}
+
+// Dump statistics to a file as tab-separated table.
+bool
+ModuleProfiler::dump(const std::string& path, const std::vector<std::string>& modules) const
+{
+  std::ofstream out(path.c_str());
+  if (not out) return false;
+  format(out, modules, true);
+  out.close();
+  return not out.fail();
+}
+
+void
+ModuleProfiler::format(std::ostream& out, const std::vector<std::string>& modules, bool tsv) const
+{
+  // width of the module name column
+  std::string::size_type width = 6;
+  for (std::vector<std::string>::const_iterator it = modules.begin(); it != modules.end(); ++ it) {
+    width = std::max(width, it->size());
+  }
+
+  const char* hdr[] = { "calls", "wall[s]", "mean[ms]", "min[ms]", "p50[ms]", "p90[ms]",
+                        "p99[ms]", "max[ms]", "cpu[s]", "cpumean[ms]" };
+  const unsigned nhdr = sizeof hdr / sizeof hdr[0];
+
+  if (tsv) {
+    out << "module\ttransition";
+    for (unsigned i = 0; i != nhdr; ++ i) out << '\t' << hdr[i];
+  } else {
+    out << std::left << std::setw(width) << "module" << "  " << std::setw(15) << "transition" << std::right;
+    for (unsigned i = 0; i != nhdr; ++ i) out << ' ' << std::setw(11) << hdr[i];
+  }
+  out << '\n';
+
+  const std::ios::fmtflags flags = out.flags();
+  out << std::fixed << std::setprecision(3);
+
+  for (unsigned imod = 0; imod != m_stats.size(); ++ imod) {
+    const std::string& name = imod < modules.size() ? modules[imod] : std::string("?");
+    for (unsigned itr = 0; itr != m_stats[imod].size(); ++ itr) {
+      const Stats& stats = m_stats[imod][itr];
+      if (stats.calls == 0) continue;
+
+      double values[] = { double(stats.calls),
+                          stats.wallSum / 1e9,
+                          ms(double(stats.wallSum) / stats.calls),
+                          ms(stats.wallMin),
+                          ms(stats.quantile(0.5)),
+                          ms(stats.quantile(0.9)),
+                          ms(stats.quantile(0.99)),
+                          ms(stats.wallMax),
+                          stats.cpuSum / 1e9,
+                          ms(double(stats.cpuSum) / stats.calls) };
+
+      if (tsv) {
+        out << name << '\t' << m_transitions[itr] << '\t' << stats.calls;
+        for (unsigned i = 1; i != nhdr; ++ i) out << '\t' << values[i];
+      } else {
+        out << std::left << std::setw(width) << name << "  " << std::setw(15) << m_transitions[itr] << std::right;
+        out << ' ' << std::setw(11) << stats.calls;
+        for (unsigned i = 1; i != nhdr; ++ i) out << ' ' << std::setw(11) << values[i];
+      }
+      out << '\n';
+    }
+  }
+
+  out.flags(flags);
+}
+
+// Returns estimate for given quantile of wall time
+uint64_t
+ModuleProfiler::Stats::quantile(double q) const
+{
+  if (calls == 0) return 0;
+
+  // rank of the requested value, 1-based
+  uint64_t rank = uint64_t(q * calls) + 1;
+  if (rank > calls) rank = calls;
+
+  uint64_t sum = 0;
+  for (unsigned b = 0; b != hist.size(); ++ b) {
+    sum += hist[b];
+    if (sum >= rank) {
+      // take middle of the bin but stay within observed range
+      uint64_t val = binLow(b) + binWidth(b) / 2;
+      if (val < wallMin) val = wallMin;
+      if (val > wallMax) val = wallMax;
+      return val;
+    }
+  }
+  return wallMax;
+}
+
+} // namespace psana
@@ -19,6 +19,7 @@
 // C/C++ Headers --
 //-----------------
 #include <signal.h>
+#include <limits>
 #include <map>
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
@@ -62,6 +63,25 @@ namespace {
     return dsetInputKeys;
   }
 
+  // Name of module instance in additional chain: chain name is added to
+  // instance name ("Pkg.Class" -> "Pkg.Class:chain", "Pkg.Class:inst" ->
+  // "Pkg.Class:chain.inst") so that module reads its parameters from a
+  // section specific to the chain or from class section
+  std::string chainModuleName(const std::string& name, const std::string& chain)
+  {
+    // optional language prefix stays in front
+    std::string::size_type start = 0;
+    std::string::size_type p = name.find(':');
+    if (p != std::string::npos) {
+      std::string language = boost::algorithm::to_lower_copy(name.substr(0, p));
+      if (language == "c++" or language == "python" or language == "py") start = p + 1;
+    }
+
+    p = name.find(':', start);
+    if (p == std::string::npos) return name + ":" + chain;
+    return name.substr(0, p + 1) + chain + "." + name.substr(p + 1);
+  }
+
   // Function which tries to guess input data type from file name extensions
   template <typename Iter>
   FileType guessType(Iter begin, Iter end) {
@@ -402,6 +422,39 @@ PSAna::dataSource(const std::vector<std::string>& input)
     cfgsvc.put(iname, "fdDataPipe", boost::lexical_cast<std::string>(dPipe));
   }
 
+  // time window from dataset specification (tmin=<sec>:tmax=<sec>, seconds since epoch),
+  // framework passes it to Index::select() of the input module at every BeginRun
+  double window[] = { 0., double(std::numeric_limits<uint32_t>::max()) };
+  bool timeWindow = false;
+  for (std::vector<std::string>::const_iterator it = inputList.begin(); it != inputList.end(); ++ it) {
+    IData::Dataset ds(*it);
+    const char* keys[] = { "tmin", "tmax" };
+    for (unsigned i = 0; i != 2; ++ i) {
+      if (not ds.exists(keys[i])) continue;
+      try {
+        window[i] = boost::lexical_cast<double>(ds.value(keys[i]));
+      } catch (const boost::bad_lexical_cast& ex) {
+        MsgLog(logger, error, "dataset option " << keys[i] << " must be a number of seconds, got " << ds.value(keys[i]));
+        return dataSrc;
+      }
+      if (window[i] < 0 or window[i] > std::numeric_limits<uint32_t>::max()) {
+        MsgLog(logger, error, "dataset option " << keys[i] << " is out of range: " << ds.value(keys[i]));
+        return dataSrc;
+      }
+      timeWindow = true;
+    }
+  }
+  if (timeWindow and ftype != IDX and ftype != RAX) {
+    MsgLog(logger, error, "dataset options tmin and tmax need indexed input, use idx or rax dataset specification");
+    return dataSrc;
+  }
+
+  // restart jumps to the position saved in checkpoint, check it before anything is loaded
+  if (cfgsvc.get("psana", "restart", false) and not cfgsvc.getStr("psana", "checkpoint", "").empty() and ftype != RAX) {
+    MsgLog(logger, error, "restart needs random access input, use rax dataset specification");
+    return dataSrc;
+  }
+
   // Load input module
   DynLoader loader;
   boost::shared_ptr<psana::InputModule> inputModule(loader.loadInputModule(iname));
@@ -413,6 +466,8 @@ PSAna::dataSource(const std::vector<std::string>& input)
   MsgLogRoot(debug, "calibDir = " << env->calibDir());
 
   // instantiate all user modules
+  std::vector<boost::shared_ptr<Module> > earlyFilters;
+  std::vector<std::pair<std::string, std::vector<boost::shared_ptr<Module> > > > chains;
   if (nworkers > 0 and workerId < 0) {
 
     // master process in multi-process mode does not need any user modules
@@ -446,10 +501,155 @@ PSAna::dataSource(const std::vector<std::string>& input)
       MsgLog(logger, trace, "psana modules parameter is empty.");
     }
 
+    // modules which filter events before they are fully read
+    std::vector<std::string> filterNames = cfgsvc.getList("psana", "early-filters", std::vector<std::string>());
+    for (std::vector<std::string>::const_iterator it = filterNames.begin(); it != filterNames.end(); ++ it) {
+      earlyFilters.push_back(loader.loadModule(*it));
+      MsgLog(logger, trace, "From psana early-filters, loaded module " << earlyFilters.back()->name());
+    }
+
+    // additional independent chains sharing the same input, modules of
+    // each chain are listed in its own section [psana:name], module instances
+    // are renamed to be configured separately from regular modules
+    std::vector<std::string> chainNames = cfgsvc.getList("psana", "chains", std::vector<std::string>());
+    for (std::vector<std::string>::const_iterator it = chainNames.begin(); it != chainNames.end(); ++ it) {
+      chains.push_back(std::make_pair(*it, std::vector<boost::shared_ptr<Module> >()));
+      std::vector<std::string> names = cfgsvc.getList("psana:" + *it, "modules", std::vector<std::string>());
+      for (std::vector<std::string>::const_iterator mit = names.begin(); mit != names.end(); ++ mit) {
+        chains.back().second.push_back(loader.loadModule(::chainModuleName(*mit, *it)));
+        MsgLog(logger, trace, "From psana chain " << *it << ", loaded module " << chains.back().second.back()->name());
+      }
+    }
+
   }
 
   // make new instance
-  dataSrc = DataSource(inputModule, m_modules, env);
+  boost::shared_ptr<EventLoop> evtLoop = boost::make_shared<EventLoop>(inputModule, m_modules, env);
+
+  // early filters are run before events are fully read
+  if (not earlyFilters.empty()) {
+    evtLoop->setEarlyFilters(earlyFilters);
+  }
+
+  // every chain gets all events from the same input
+  for (unsigned i = 0; i != chains.size(); ++ i) {
+    evtLoop->addChain(chains[i].first, chains[i].second);
+  }
+
+  // read only events in the time window
+  if (timeWindow) {
+    EventTime t[2];
+    for (unsigned i = 0; i != 2; ++ i) {
+      const uint64_t sec = uint64_t(window[i]);
+      const uint64_t nsec = uint64_t((window[i] - sec) * 1e9);
+      t[i] = EventTime((sec << 32) | nsec, 0);
+    }
+    MsgLog(logger, trace, "time window " << window[0] << " - " << window[1]);
+    evtLoop->setTimeWindow(t[0], t[1]);
+  }
+
+  // time budgets for live monitoring, in milliseconds
+  double moduleBudget = cfgsvc.get("psana", "module-budget-ms", 0.);
+  double eventBudget = cfgsvc.get("psana", "event-budget-ms", 0.);
+  if (moduleBudget > 0 or eventBudget > 0) {
+    MsgLog(logger, trace, "time budgets: module " << moduleBudget << " ms, event " << eventBudget << " ms");
+    evtLoop->setTimeBudget(moduleBudget, eventBudget);
+  }
+
+  // in live mode skip events if processing falls behind by more than this number of events
+  unsigned liveMaxLag = cfgsvc.get("psana", "live-max-lag", 0U);
+  if (liveMaxLag > 0) {
+    MsgLog(logger, trace, "live mode maximum lag " << liveMaxLag << " events");
+    evtLoop->setLiveMaxLag(liveMaxLag);
+  }
+
+  // save checkpoints at calib cycle boundaries and optionally resume from the last one,
+  // every worker in multi-process mode has its own file
+  std::string checkpoint = cfgsvc.getStr("psana", "checkpoint", "");
+  if (not checkpoint.empty() and workerId >= 0) {
+    checkpoint += "." + boost::lexical_cast<std::string>(workerId);
+  }
+  if (not checkpoint.empty()) {
+    unsigned interval = cfgsvc.get("psana", "checkpoint-interval", 1U);
+    MsgLog(logger, trace, "save checkpoint to " << checkpoint << " every " << interval << " calib cycles");
+    evtLoop->setCheckpoint(checkpoint, interval);
+  }
+  if (cfgsvc.get("psana", "restart", false)) {
+    if (checkpoint.empty()) {
+      MsgLog(logger, warning, "restart requested but psana.checkpoint is not set, starting from the beginning");
+    } else {
+      evtLoop->setResume(checkpoint);
+    }
+  }
+
+  // per-module timing statistics
+  if (cfgsvc.get("psana", "profile", false)) {
+    evtLoop->enableProfiling(cfgsvc.getStr("psana", "profile-file", ""));
+  }
+
+  // read input in a separate thread, the option gives the depth of the queue
+  unsigned readAhead = cfgsvc.get("psana", "read-ahead", 0U);
+  if (readAhead > 0) {
+    MsgLog(logger, trace, "enable read-ahead with depth " << readAhead);
+    evtLoop->setReadAhead(readAhead);
+  }
+
+  // number of reads kept in flight by asynchronous input modules
+  unsigned asyncDepth = cfgsvc.get("psana", "async-depth", 0U);
+  if (asyncDepth > 0) {
+    MsgLog(logger, trace, "keep up to " << asyncDepth << " reads in flight");
+    evtLoop->setAsyncDepth(asyncDepth);
+  }
+
+  // directory for products of cacheable modules, empty means no caching
+  std::string productCache = cfgsvc.getStr("psana", "product-cache", "");
+  if (not productCache.empty()) {
+    MsgLog(logger, trace, "cache module products in " << productCache);
+    evtLoop->setProductCache(productCache);
+  }
+
+  // process events in parallel threads, all modules have to support cloning
+  unsigned nThreads = cfgsvc.get("psana", "threads", 1U);
+  if (nThreads > 1) {
+    MsgLog(logger, trace, "process events in " << nThreads << " threads");
+    evtLoop->setThreads(nThreads);
+  }
+
+  // run independent modules in parallel threads
+  unsigned nModuleThreads = cfgsvc.get("psana", "module-threads", 1U);
+  if (nModuleThreads > 1) {
+    MsgLog(logger, trace, "run independent modules in " << nModuleThreads << " threads");
+    evtLoop->setModuleThreads(nModuleThreads);
+  }
+
+  // run begin transitions of independent modules in parallel threads
+  unsigned nBeginThreads = cfgsvc.get("psana", "begin-threads", 1U);
+  if (nBeginThreads > 1) {
+    MsgLog(logger, trace, "run begin transitions of independent modules in " << nBeginThreads << " threads");
+    evtLoop->setBeginThreads(nBeginThreads);
+  }
+
+  // pass events to modules in batches
+  unsigned batchSize = cfgsvc.get("psana", "batch-size", 1U);
+  if (batchSize > 1) {
+    MsgLog(logger, trace, "process events in batches of " << batchSize);
+    evtLoop->setBatchSize(batchSize);
+  }
+
+  // add "__psana_skip_event__" key to skipped events returned to the caller,
+  // existing code relies on it, disabling saves one update per skipped event
+  if (not cfgsvc.get("psana", "skip-event-key", true)) {
+    evtLoop->setSkipEventKey(false);
+  }
+
+  // number of released event objects kept for reuse, zero disables reuse
+  unsigned eventPoolSize = cfgsvc.get("psana", "event-pool-size", 0U);
+  if (eventPoolSize > 0) {
+    MsgLog(logger, trace, "keep up to " << eventPoolSize << " events for reuse");
+    evtLoop->setEventPoolSize(eventPoolSize);
+  }
+
+  dataSrc = DataSource(evtLoop);
 
   return dataSrc;
 }
@@ -97,6 +97,7 @@ PSAnaApp::PSAnaApp ( const std::string& appName )
   , m_maxEventsOpt( parser(), "n,num-events", "number", "maximum number of events to process, 0 means all", 0U )
   , m_skipEventsOpt( parser(), "s,skip-events", "number", "number of events to skip", 0U )
   , m_parallelOpt( parser(), "p,num-cpu", "number", "number greater than 0 enables multi-processing", 0U )
+  , m_restartOpt( parser(), "r,restart", "resume from the last checkpoint saved in psana.checkpoint file", false )
   , m_optionsOpt( parser(), "o,option", "string", "configuration options, format: module.option[=value]" )
   , m_datasets( parser(), "dataset", "input dataset specification (list of file names or exp=cxi12345:run=123:...)", std::vector<std::string>() )
 {
@@ -261,6 +262,11 @@ PSAnaApp::setConfigFileAndOptions(std::string &cfgFile, std::map<std::string, st
       options["psana.parallel"] = boost::lexical_cast<std::string>(m_parallelOpt.value());
   }
 
+  // resume from checkpoint
+  if (m_restartOpt.value()) {
+      options["psana.restart"] = "true";
+  }
+
   // set calib dir name if specified
   if (not m_calibDirOpt.value().empty()) {
     options["psana.calib-dir"] = m_calibDirOpt.value();
@@ -0,0 +1,254 @@
+//--------------------------------------------------------------------------
+// File and Version Information:
+//     $Id$
+//
+// Description:
+//     Class ProductCache...
+//
+// Author List:
+//     Andy Salnikov
+//
+//------------------------------------------------------------------------
+
+//-----------------------
+// This Class's Header --
+//-----------------------
+#include "psana/ProductCache.h"
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <boost/filesystem.hpp>
+#include <boost/format.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/locks.hpp>
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+#include "MsgLogger/MsgLogger.h"
+#include "psana/Exceptions.h"
+#include "PSEvt/EventId.h"
+
+//-----------------------------------------------------------------------
+// Local Macros, Typedefs, Structures, Unions and Forward Declarations --
+//-----------------------------------------------------------------------
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+  const char* logger = "ProductCache";
+
+  // file starts with this string, change it if record format changes
+  const char magic[] = "PSCACHE2";
+  const unsigned magicSize = sizeof magic - 1;
+
+  // record header: run, seconds, nanoseconds, fiducials, status, data size
+  const unsigned headerWords = 6;
+
+  // common prefix of the names of module cache files, slashes in module
+  // name are replaced
+  std::string cacheBaseName(const psana::Module& module, const std::string& experiment)
+  {
+    std::string name = module.name();
+    std::replace(name.begin(), name.end(), '/', '_');
+    name = boost::str(boost::format("%1%-%2$016x") % name % module.configHash());
+    if (not experiment.empty()) name += "-" + experiment;
+    return name;
+  }
+
+  // name of the file written by this process
+  std::string ownFileName(const std::string& baseName)
+  {
+    char host[256];
+    if (gethostname(host, sizeof host) != 0) host[0] = '\0';
+    host[sizeof host - 1] = '\0';
+    return boost::str(boost::format("%1%.%2%-%3%.cache") % baseName % host % getpid());
+  }
+
+}
+
+//             ----------------------------------------
+//             -- Public Function Member Definitions --
+//             ----------------------------------------
+
+namespace psana {
+
+//----------------
+// Constructors --
+//----------------
+ProductCache::ProductCache(const std::string& dir, const Module& module, const std::string& experiment)
+  : m_paths()
+  , m_files()
+  , m_index()
+  , m_end(0)
+  , m_nHits(0)
+  , m_nMisses(0)
+  , m_mutex()
+{
+  boost::system::error_code ec;
+  fs::create_directories(dir, ec);
+
+  const std::string baseName = ::cacheBaseName(module, experiment);
+  const std::string ownName = ::ownFileName(baseName);
+  m_paths.push_back((fs::path(dir) / ownName).string());
+
+  // create own file if it does not exist
+  if (not fs::exists(m_paths.front())) {
+    std::ofstream out(m_paths.front().c_str(), std::ios::binary);
+    out.write(::magic, ::magicSize);
+  }
+
+  m_files.push_back(boost::make_shared<std::fstream>(m_paths.front().c_str(), std::ios::in | std::ios::out | std::ios::binary));
+  if (not *m_files.front()) {
+    throw ExceptionErrno(ERR_LOC, "failed to open product cache file " + m_paths.front());
+  }
+  m_end = readIndex(0);
+  if (m_end == 0) {
+    throw ExceptionAbort(ERR_LOC, "file " + m_paths.front() + " is not a product cache");
+  }
+
+  // files written by other processes are only read
+  for (fs::directory_iterator it(dir, ec), end; not ec and it != end; it.increment(ec)) {
+    const std::string name = it->path().filename().string();
+    if (name == ownName or name.size() <= baseName.size() + 7) continue;
+    if (name.compare(0, baseName.size() + 1, baseName + ".") != 0) continue;
+    if (name.compare(name.size() - 6, 6, ".cache") != 0) continue;
+
+    m_paths.push_back(it->path().string());
+    m_files.push_back(boost::make_shared<std::fstream>(m_paths.back().c_str(), std::ios::in | std::ios::binary));
+    if (not *m_files.back() or readIndex(m_files.size() - 1) == 0) {
+      MsgLog(logger, warning, "ignoring product cache file " << m_paths.back());
+      m_files.back()->close();
+    }
+  }
+
+  MsgLog(logger, info, "product cache " << dir << "/" << baseName << " has " << m_index.size()
+      << " events in " << m_files.size() << " files");
+}
+
+//--------------
+// Destructor --
+//--------------
+ProductCache::~ProductCache()
+{
+}
+
+// Build key from event id, returns false if event does not have id
+bool
+ProductCache::makeKey(PSEvt::Event& evt, Key& key)
+{
+  boost::shared_ptr<PSEvt::EventId> eid = evt.get();
+  if (not eid) return false;
+  key = Key(eid->run(), eid->time().sec(), eid->time().nsec(), eid->fiducials());
+  return true;
+}
+
+// Find record for given event.
+bool
+ProductCache::find(const Key& key, Module::Status& status, std::string& data)
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+
+  std::map<Key, Record>::const_iterator it = m_index.find(key);
+  if (it == m_index.end()) {
+    ++ m_nMisses;
+    return false;
+  }
+
+  const Record& rec = it->second;
+  std::fstream& file = *m_files[rec.file];
+  data.resize(rec.size);
+  file.clear();
+  file.seekg(rec.offset);
+  if (rec.size > 0) file.read(&data[0], rec.size);
+  if (not file) {
+    MsgLog(logger, warning, "failed to read record from product cache " << m_paths[rec.file]);
+    file.clear();
+    ++ m_nMisses;
+    return false;
+  }
+
+  status = Module::Status(rec.status);
+  ++ m_nHits;
+  return true;
+}
+
+// Add new record to the cache, existing records are not replaced
+void
+ProductCache::store(const Key& key, Module::Status status, const std::string& data)
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+
+  if (m_index.count(key)) return;
+
+  // only this process writes to own file
+  uint32_t header[::headerWords] = { key.run, key.sec, key.nsec, key.fiducials, uint32_t(status), uint32_t(data.size()) };
+  std::fstream& file = *m_files.front();
+  file.clear();
+  file.seekp(m_end);
+  file.write((const char*)header, sizeof header);
+  file.write(data.data(), data.size());
+  file.flush();
+  if (not file) {
+    MsgLog(logger, warning, "failed to write record to product cache " << m_paths.front());
+    file.clear();
+    return;
+  }
+
+  m_index.insert(std::make_pair(key, Record(0, m_end + sizeof header, data.size(), status)));
+  m_end += sizeof header + data.size();
+}
+
+// Returns number of successful lookups
+unsigned long
+ProductCache::nHits() const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  return m_nHits;
+}
+
+// Returns number of failed lookups
+unsigned long
+ProductCache::nMisses() const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  return m_nMisses;
+}
+
+// Read index of all complete records in one file
+uint64_t
+ProductCache::readIndex(unsigned index)
+{
+  std::fstream& file = *m_files[index];
+  const std::string& path = m_paths[index];
+
+  char buf[::magicSize];
+  file.read(buf, ::magicSize);
+  if (not file or std::memcmp(buf, ::magic, ::magicSize) != 0) return 0;
+  uint64_t end = ::magicSize;
+
+  const uint64_t fileSize = fs::file_size(path);
+  uint32_t header[::headerWords];
+  while (file.read((char*)header, sizeof header)) {
+    const uint64_t dataOffset = end + sizeof header;
+    if (dataOffset + header[5] > fileSize) break;
+    // the same event may be in several files, first one is used
+    m_index.insert(std::make_pair(Key(header[0], header[1], header[2], header[3]),
+        Record(index, dataOffset, header[5], header[4])));
+    end = dataOffset + header[5];
+    file.seekg(end);
+  }
+  if (end != fileSize) {
+    MsgLog(logger, warning, "incomplete record at the end of product cache " << path << " is ignored");
+  }
+  file.clear();
+  return end;
+}
+
+} // namespace psana
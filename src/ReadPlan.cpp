@@ -0,0 +1,83 @@
+//--------------------------------------------------------------------------
+// File and Version Information:
+//     $Id$
+//
+// Description:
+//     Class ReadPlan...
+//
+// Author List:
+//     Andy Salnikov
+//
+//------------------------------------------------------------------------
+
+//-----------------------
+// This Class's Header --
+//-----------------------
+#include "psana/ReadPlan.h"
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+#include <algorithm>
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+
+//-----------------------------------------------------------------------
+// Local Macros, Typedefs, Structures, Unions and Forward Declarations --
+//-----------------------------------------------------------------------
+
+//             ----------------------------------------
+//             -- Public Function Member Definitions --
+//             ----------------------------------------
+
+namespace psana {
+
+// Add one event, returns its index in the batch
+unsigned
+ReadPlan::add(const std::vector<std::string>& filenames, const std::vector<int64_t>& offsets)
+{
+  const unsigned event = m_nEvents ++;
+  const unsigned nFiles = std::min(filenames.size(), offsets.size());
+  for (unsigned i = 0; i != nFiles; ++ i) {
+    FilePiece fp;
+    fp.filename = filenames[i];
+    fp.piece.event = event;
+    fp.piece.file = i;
+    fp.piece.offset = offsets[i];
+    m_pieces.push_back(fp);
+  }
+  return event;
+}
+
+// Build list of reads ordered by file name and offset
+std::vector<ReadPlan::Read>
+ReadPlan::reads() const
+{
+  std::vector<FilePiece> pieces(m_pieces);
+  std::stable_sort(pieces.begin(), pieces.end());
+
+  std::vector<Read> reads;
+  for (std::vector<FilePiece>::const_iterator it = pieces.begin(); it != pieces.end(); ++ it) {
+    const int64_t end = it->piece.offset + m_sizeHint;
+    if (not reads.empty()) {
+      Read& last = reads.back();
+      if (last.filename == it->filename and it->piece.offset - last.end <= m_maxGap and end - last.begin <= m_maxSize) {
+        // extend previous read
+        last.end = std::max(last.end, end);
+        last.pieces.push_back(it->piece);
+        continue;
+      }
+    }
+    Read read;
+    read.filename = it->filename;
+    read.begin = it->piece.offset;
+    read.end = end;
+    read.pieces.push_back(it->piece);
+    reads.push_back(read);
+  }
+  return reads;
+}
+
+} // namespace psana
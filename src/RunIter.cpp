@@ -77,7 +77,7 @@ RunIter::nextWithEvent()
 
   // Go to a BeginRun transition
   while (true) {
-    EventLoop::value_type nxt = m_evtLoop->next();
+    EventLoop::value_type nxt = m_evtLoop->nextTransition();
     if (nxt.first == EventLoop::None) {
       // nothing left there
       break;
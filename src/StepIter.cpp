@@ -67,7 +67,7 @@ StepIter::nextWithEvent()
   }
   
   while (true) {
-    EventLoop::value_type nxt = m_evtLoop->next();
+    EventLoop::value_type nxt = m_evtLoop->nextTransition();
     if (nxt.first == EventLoop::None) {
       // no events left
       m_stopType = EventLoop::Event;
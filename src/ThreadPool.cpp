@@ -0,0 +1,128 @@
+//--------------------------------------------------------------------------
+// File and Version Information:
+//     $Id$
+//
+// Description:
+//     Class ThreadPool...
+//
+// Author List:
+//     Andy Salnikov
+//
+//------------------------------------------------------------------------
+
+//-----------------------
+// This Class's Header --
+//-----------------------
+#include "psana/ThreadPool.h"
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+#include <exception>
+#include <boost/bind.hpp>
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+#include "psana/Exceptions.h"
+
+//-----------------------------------------------------------------------
+// Local Macros, Typedefs, Structures, Unions and Forward Declarations --
+//-----------------------------------------------------------------------
+
+//             ----------------------------------------
+//             -- Public Function Member Definitions --
+//             ----------------------------------------
+
+namespace psana {
+
+//----------------
+// Constructors --
+//----------------
+ThreadPool::ThreadPool(unsigned nThreads)
+  : m_threads()
+  , m_tasks(0)
+  , m_next(0)
+  , m_running(0)
+  , m_stop(false)
+  , m_error()
+{
+  if (nThreads == 0) nThreads = 1;
+  for (unsigned i = 0; i != nThreads; ++ i) {
+    m_threads.push_back(new boost::thread(boost::bind(&ThreadPool::worker, this)));
+  }
+}
+
+//--------------
+// Destructor --
+//--------------
+ThreadPool::~ThreadPool()
+{
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_stop = true;
+    m_workCond.notify_all();
+  }
+  for (std::vector<boost::thread*>::iterator it = m_threads.begin(); it != m_threads.end(); ++ it) {
+    (*it)->join();
+    delete *it;
+  }
+}
+
+// Execute all tasks and wait until they finish.
+void
+ThreadPool::run(const std::vector<Task>& tasks)
+{
+  if (tasks.empty()) return;
+
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  m_tasks = &tasks;
+  m_next = 0;
+  m_running = 0;
+  m_error.clear();
+  m_workCond.notify_all();
+
+  while (m_next < tasks.size() or m_running > 0) {
+    m_doneCond.wait(lock);
+  }
+  m_tasks = 0;
+
+  if (not m_error.empty()) {
+    throw Exception(ERR_LOC, m_error);
+  }
+}
+
+// body of the worker thread
+void
+ThreadPool::worker()
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  while (true) {
+
+    while (not m_stop and (m_tasks == 0 or m_next >= m_tasks->size())) {
+      m_workCond.wait(lock);
+    }
+    if (m_stop) break;
+
+    const Task& task = (*m_tasks)[m_next ++];
+    ++ m_running;
+
+    // run the task without holding a lock
+    lock.unlock();
+    std::string error;
+    try {
+      task();
+    } catch (const std::exception& ex) {
+      error = ex.what();
+    } catch (...) {
+      error = "unknown exception in a thread pool task";
+    }
+    lock.lock();
+
+    if (m_error.empty() and not error.empty()) m_error = error;
+    -- m_running;
+    if (m_next >= m_tasks->size() and m_running == 0) m_doneCond.notify_all();
+  }
+}
+
+} // namespace psana
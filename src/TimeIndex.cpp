@@ -0,0 +1,248 @@
+//--------------------------------------------------------------------------
+// File and Version Information:
+//     $Id$
+//
+// Description:
+//     Class TimeIndex...
+//
+// Author List:
+//     Andy Salnikov
+//
+//------------------------------------------------------------------------
+
+//-----------------------
+// This Class's Header --
+//-----------------------
+#include "psana/TimeIndex.h"
+
+//-----------------
+// C/C++ Headers --
+//-----------------
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+#include "psana/Exceptions.h"
+
+//-----------------------------------------------------------------------
+// Local Macros, Typedefs, Structures, Unions and Forward Declarations --
+//-----------------------------------------------------------------------
+
+namespace {
+
+  // file starts with this string, change it if format changes
+  const char magic[] = "PSIDX001";
+  const unsigned magicSize = sizeof magic - 1;
+
+  // file header which follows magic: numbers of entries, steps and runs
+  const unsigned headerSize = magicSize + 3 * sizeof(uint64_t);
+
+  // order of entries in file
+  bool entryLess(const psana::TimeIndex::Entry& lhs, const psana::TimeIndex::Entry& rhs)
+  {
+    if (lhs.time != rhs.time) return lhs.time < rhs.time;
+    return lhs.fiducial < rhs.fiducial;
+  }
+
+}
+
+//             ----------------------------------------
+//             -- Public Function Member Definitions --
+//             ----------------------------------------
+
+namespace psana {
+
+// Add one event to current step
+void
+TimeIndex::Writer::add(const EventTime& time, uint32_t file, int64_t offset)
+{
+  if (m_stepBegin.empty()) addStep();
+  Entry entry;
+  entry.time = time.time();
+  entry.fiducial = time.fiducial();
+  entry.file = file;
+  entry.offset = offset;
+  m_entries.push_back(entry);
+}
+
+// Write index file.
+void
+TimeIndex::Writer::write(const std::string& path)
+{
+  // sort events in every step, steps have to follow each other
+  for (unsigned i = 0; i != m_stepBegin.size(); ++ i) {
+    const uint64_t end = i+1 < m_stepBegin.size() ? m_stepBegin[i+1] : m_entries.size();
+    std::sort(m_entries.begin() + m_stepBegin[i], m_entries.begin() + end, ::entryLess);
+    if (i > 0 and m_stepBegin[i] > 0 and end > m_stepBegin[i] and
+        ::entryLess(m_entries[m_stepBegin[i]], m_entries[m_stepBegin[i] - 1])) {
+      throw ExceptionAbort(ERR_LOC, "steps overlap in time, cannot write index " + path);
+    }
+  }
+
+  const std::string tmpPath = path + ".tmp";
+  std::ofstream out(tmpPath.c_str(), std::ios::binary | std::ios::trunc);
+
+  const uint64_t header[3] = { m_entries.size(), m_stepBegin.size(), m_runs.size() };
+  out.write(::magic, ::magicSize);
+  out.write((const char*)header, sizeof header);
+  if (not m_entries.empty()) out.write((const char*)&m_entries[0], m_entries.size() * sizeof(Entry));
+  if (not m_stepBegin.empty()) out.write((const char*)&m_stepBegin[0], m_stepBegin.size() * sizeof(uint64_t));
+  if (not m_runs.empty()) out.write((const char*)&m_runs[0], m_runs.size() * sizeof(uint32_t));
+
+  out.close();
+  if (not out) {
+    throw ExceptionErrno(ERR_LOC, "failed to write index file " + tmpPath);
+  }
+  if (rename(tmpPath.c_str(), path.c_str()) != 0) {
+    throw ExceptionErrno(ERR_LOC, "failed to rename index file " + tmpPath + " to " + path);
+  }
+}
+
+//----------------
+// Constructors --
+//----------------
+TimeIndex::TimeIndex(const std::string& path)
+  : m_path(path)
+  , m_addr(0)
+  , m_mapSize(0)
+  , m_entries(0)
+  , m_nEntries(0)
+  , m_stepBegin(0)
+  , m_nSteps(0)
+  , m_runs()
+  , m_times()
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) throw ExceptionErrno(ERR_LOC, "failed to open index file " + path);
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw ExceptionErrno(ERR_LOC, "failed to stat index file " + path);
+  }
+  m_mapSize = st.st_size;
+  if (m_mapSize >= ::headerSize) {
+    m_addr = mmap(0, m_mapSize, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (m_addr == MAP_FAILED) m_addr = 0;
+
+  // check that file is complete
+  const char* data = static_cast<const char*>(m_addr);
+  uint64_t header[3] = { 0, 0, 0 };
+  bool ok = data != 0 and std::memcmp(data, ::magic, ::magicSize) == 0;
+  if (ok) {
+    std::memcpy(header, data + ::magicSize, sizeof header);
+    ok = ::headerSize + header[0] * sizeof(Entry) + header[1] * sizeof(uint64_t) + header[2] * sizeof(uint32_t) == m_mapSize;
+  }
+  if (not ok) {
+    if (m_addr) munmap(m_addr, m_mapSize);
+    throw ExceptionErrno(ERR_LOC, "file " + path + " is not a valid index file");
+  }
+
+  m_entries = reinterpret_cast<const Entry*>(data + ::headerSize);
+  m_nEntries = header[0];
+  m_stepBegin = reinterpret_cast<const uint64_t*>(m_entries + m_nEntries);
+  m_nSteps = header[1];
+  const uint32_t* runs = reinterpret_cast<const uint32_t*>(m_stepBegin + m_nSteps);
+  m_runs.assign(runs, runs + header[2]);
+}
+
+//--------------
+// Destructor --
+//--------------
+TimeIndex::~TimeIndex()
+{
+  if (m_addr) munmap(m_addr, m_mapSize);
+}
+
+// Find entry for given event time, returns zero pointer if event is not in index
+const TimeIndex::Entry*
+TimeIndex::find(const EventTime& time) const
+{
+  Entry key;
+  key.time = time.time();
+  key.fiducial = time.fiducial();
+  const Entry* end = m_entries + m_nEntries;
+  const Entry* it = std::lower_bound(m_entries, end, key, ::entryLess);
+  if (it == end or it->time != key.time or it->fiducial != key.fiducial) return 0;
+  return it;
+}
+
+// Find file spans for events in time window [t0, t1).
+uint64_t
+TimeIndex::select(const EventTime& t0, const EventTime& t1, std::vector<Span>& spans) const
+{
+  spans.clear();
+
+  Entry key;
+  key.fiducial = 0;
+  key.time = t0.time();
+  const Entry* end = m_entries + m_nEntries;
+  const Entry* first = std::lower_bound(m_entries, end, key, ::entryLess);
+  key.time = t1.time();
+  const Entry* last = std::lower_bound(first, end, key, ::entryLess);
+
+  std::map<uint32_t, Span> files;
+  for (const Entry* it = first; it != last; ++ it) {
+    std::map<uint32_t, Span>::iterator fit = files.find(it->file);
+    if (fit == files.end()) {
+      Span span = { it->file, it->offset, it->offset, 1 };
+      files.insert(std::make_pair(it->file, span));
+    } else {
+      fit->second.begin = std::min(fit->second.begin, it->offset);
+      fit->second.last = std::max(fit->second.last, it->offset);
+      ++ fit->second.nEvents;
+    }
+  }
+  for (std::map<uint32_t, Span>::const_iterator it = files.begin(); it != files.end(); ++ it) {
+    spans.push_back(it->second);
+  }
+  return last - first;
+}
+
+// Returns range of entry indices [begin, end) for given step
+void
+TimeIndex::stepRange(unsigned step, uint64_t& begin, uint64_t& end) const
+{
+  begin = end = 0;
+  if (step >= m_nSteps) return;
+  begin = m_stepBegin[step];
+  end = step+1 < m_nSteps ? m_stepBegin[step+1] : m_nEntries;
+}
+
+// Returns times of all events
+void
+TimeIndex::times(Index::EventTimeIter& begin, Index::EventTimeIter& end)
+{
+  if (m_times.size() != m_nEntries) {
+    m_times.clear();
+    m_times.reserve(m_nEntries);
+    for (uint64_t i = 0; i != m_nEntries; ++ i) {
+      m_times.push_back(EventTime(m_entries[i].time, m_entries[i].fiducial));
+    }
+  }
+  begin = m_times.begin();
+  end = m_times.end();
+}
+
+// Returns times of events in one step
+void
+TimeIndex::times(unsigned step, Index::EventTimeIter& begin, Index::EventTimeIter& end)
+{
+  uint64_t first, last;
+  stepRange(step, first, last);
+  times(begin, end);
+  end = begin + last;
+  begin += first;
+}
+
+} // namespace psana
@@ -0,0 +1,236 @@
+//--------------------------------------------------------------------------
+// File and Version Information:
+// 	$Id$
+//
+// Description:
+//	Benchmark of the framework overhead in EventLoop.
+//
+//------------------------------------------------------------------------
+
+//---------------
+// C++ Headers --
+//---------------
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <boost/make_shared.hpp>
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+#include "psana/EventLoop.h"
+#include "psana/InputModule.h"
+#include "PSEnv/Env.h"
+
+using namespace psana ;
+
+/**
+ *  Benchmark which measures framework overhead per event without real data.
+ *  Synthetic input module generates runs, calib cycles and events with
+ *  payload of given size, every user module spends given time per event.
+ *  Overhead is the total time minus the time spent inside user modules.
+ *  This is not a unit test, it is not run by default; run it with -h to
+ *  see the options.
+ */
+
+namespace {
+
+// number of calls to malloc, counted for the whole program
+unsigned long nAllocations = 0;
+
+uint64_t now()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+// Benchmark parameters
+struct Config {
+  Config() : nRuns(1), nSteps(10), nEvents(10000), payload(0), nModules(10), cost(0),
+             skipPercent(0), skipKey(true), nThreads(1), batchSize(1), poolSize(0) {}
+  unsigned nRuns;      ///< Number of runs
+  unsigned nSteps;     ///< Number of calib cycles per run
+  unsigned nEvents;    ///< Number of events per calib cycle
+  unsigned payload;    ///< Size of data added to every event, bytes
+  unsigned nModules;   ///< Number of user modules
+  unsigned cost;       ///< Time spent by every module per event, ns
+  unsigned skipPercent;  ///< Percentage of events skipped by the first module
+  bool skipKey;        ///< EventLoop::setSkipEventKey()
+  unsigned nThreads;   ///< EventLoop::setThreads()
+  unsigned batchSize;  ///< EventLoop::setBatchSize()
+  unsigned poolSize;   ///< EventLoop::setEventPoolSize()
+};
+
+// Input module which generates regular pattern of transitions and events
+class SyntheticInputModule: public InputModule {
+public:
+
+  SyntheticInputModule(const Config& cfg)
+    : InputModule("SyntheticInputModule"), m_cfg(cfg), m_run(0), m_step(0), m_event(0), m_state(Stop) {}
+
+  virtual void beginJob(Event& evt, Env& env) {}
+
+  virtual Status event(Event& evt, Env& env) {
+    switch (m_state) {
+    case Stop:
+      // not started yet or previous run finished
+      if (m_run == m_cfg.nRuns) return Stop;
+      ++ m_run;
+      m_step = 0;
+      return m_state = BeginRun;
+    case BeginRun:
+    case EndCalibCycle:
+      if (m_step == m_cfg.nSteps) {
+        m_state = Stop;
+        return EndRun;
+      }
+      ++ m_step;
+      m_event = 0;
+      return m_state = BeginCalibCycle;
+    case BeginCalibCycle:
+    case DoEvent:
+      if (m_event == m_cfg.nEvents) return m_state = EndCalibCycle;
+      ++ m_event;
+      if (m_cfg.payload > 0) evt.put(boost::make_shared<std::vector<char> >(m_cfg.payload), "payload");
+      return m_state = DoEvent;
+    default:
+      return Stop;
+    }
+  }
+
+  virtual void endJob(Event& evt, Env& env) {}
+
+  // environment is never updated, all threading options can be used
+  virtual bool updatesEnv() const { return false; }
+
+private:
+  Config m_cfg;
+  unsigned m_run;
+  unsigned m_step;
+  unsigned m_event;
+  Status m_state;
+};
+
+// User module which spins for a given time on every event and measures it,
+// optionally skips given percentage of events
+class BusyModule: public Module {
+public:
+
+  BusyModule(unsigned cost, unsigned skipPercent = 0)
+    : Module("BusyModule"), elapsed(0), m_cost(cost), m_skipPercent(skipPercent), m_count(0) {}
+
+  virtual void event(Event& evt, Env& env) {
+    if (m_skipPercent > 0 and m_count ++ % 100 < m_skipPercent) skip();
+    if (m_cost == 0) return;
+    const uint64_t start = ::now();
+    uint64_t stop = start;
+    while ((stop = ::now()) - start < m_cost) {}
+    elapsed += stop - start;
+  }
+
+  virtual Module* clone() const { return new BusyModule(m_cost, m_skipPercent); }
+
+  uint64_t elapsed;  ///< Total time spent in event(), ns
+private:
+  unsigned m_cost;
+  unsigned m_skipPercent;
+  unsigned m_count;
+};
+
+void usage(const char* app)
+{
+  std::cout << "Usage: " << app << " [options]\n"
+            << "  -r number  number of runs (default 1)\n"
+            << "  -s number  number of calib cycles per run (default 10)\n"
+            << "  -e number  number of events per calib cycle (default 10000)\n"
+            << "  -b bytes   size of payload added to every event (default 0)\n"
+            << "  -m number  number of user modules (default 10)\n"
+            << "  -c ns      time spent by every module per event (default 0)\n"
+            << "  -k percent percentage of events skipped by the first module (default 0)\n"
+            << "  -K         do not add skip key to returned events\n"
+            << "  -t number  number of threads (default 1)\n"
+            << "  -B number  batch size (default 1)\n"
+            << "  -P number  event pool size (default 0)\n";
+}
+
+}
+
+// count all allocations; operator new and delete are not replaced, they
+// still come in matching pairs and use malloc/free of glibc underneath
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* malloc(size_t size)
+{
+  __sync_fetch_and_add(&nAllocations, 1UL);
+  return __libc_malloc(size);
+}
+
+int main(int argc, char** argv)
+{
+  Config cfg;
+  int c;
+  while ((c = getopt(argc, argv, "r:s:e:b:m:c:k:Kt:B:P:h")) != -1) {
+    switch (c) {
+    case 'r': cfg.nRuns = strtoul(optarg, 0, 0); break;
+    case 's': cfg.nSteps = strtoul(optarg, 0, 0); break;
+    case 'e': cfg.nEvents = strtoul(optarg, 0, 0); break;
+    case 'b': cfg.payload = strtoul(optarg, 0, 0); break;
+    case 'm': cfg.nModules = strtoul(optarg, 0, 0); break;
+    case 'c': cfg.cost = strtoul(optarg, 0, 0); break;
+    case 'k': cfg.skipPercent = strtoul(optarg, 0, 0); break;
+    case 'K': cfg.skipKey = false; break;
+    case 't': cfg.nThreads = strtoul(optarg, 0, 0); break;
+    case 'B': cfg.batchSize = strtoul(optarg, 0, 0); break;
+    case 'P': cfg.poolSize = strtoul(optarg, 0, 0); break;
+    case 'h': usage(argv[0]); return 0;
+    default: usage(argv[0]); return 2;
+    }
+  }
+
+  std::vector<boost::shared_ptr<Module> > modules;
+  std::vector<boost::shared_ptr<BusyModule> > busy;
+  for (unsigned i = 0; i != cfg.nModules; ++ i) {
+    busy.push_back(boost::make_shared<BusyModule>(cfg.cost, i == 0 ? cfg.skipPercent : 0));
+    modules.push_back(busy.back());
+  }
+
+  boost::shared_ptr<AliasMap> amap = boost::make_shared<AliasMap>();
+  boost::shared_ptr<PSEnv::IExpNameProvider> expNameProvider;
+  boost::shared_ptr<PSEnv::Env> env = boost::make_shared<PSEnv::Env>("", expNameProvider, "", amap, 0);
+  boost::shared_ptr<InputModule> input = boost::make_shared<SyntheticInputModule>(cfg);
+  EventLoop evtLoop(input, modules, env);
+  evtLoop.setThreads(cfg.nThreads);
+  evtLoop.setBatchSize(cfg.batchSize);
+  evtLoop.setEventPoolSize(cfg.poolSize);
+  evtLoop.setSkipEventKey(cfg.skipKey);
+
+  unsigned long nEvents = 0;
+  const unsigned long allocStart = nAllocations;
+  const uint64_t start = ::now();
+  EventLoop::value_type evt;
+  while ((evt = evtLoop.next()).first != EventLoop::None) {
+    if (evt.first == EventLoop::Event) ++ nEvents;
+  }
+  const uint64_t total = ::now() - start;
+  const unsigned long nAlloc = nAllocations - allocStart;
+
+  // in multi-threaded mode copies of modules do the work, their time is estimated
+  uint64_t moduleTime = 0;
+  for (unsigned i = 0; i != busy.size(); ++ i) moduleTime += busy[i]->elapsed;
+  if (cfg.nThreads > 1) moduleTime = uint64_t(cfg.cost) * cfg.nModules * nEvents / cfg.nThreads;
+
+  if (nEvents == 0) {
+    std::cout << "no events processed\n";
+    return 1;
+  }
+  const double sec = total * 1e-9;
+  std::cout << "events:               " << nEvents << "\n"
+            << "events/s:             " << nEvents / sec << "\n"
+            << "ns per event:         " << double(total) / nEvents << "\n"
+            << "overhead ns/event:    " << double(total - std::min(total, moduleTime)) / nEvents << "\n"
+            << "allocations/event:    " << double(nAlloc) / nEvents << "\n";
+  return 0;
+}
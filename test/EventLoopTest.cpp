@@ -11,16 +11,27 @@
 // C++ Headers --
 //---------------
 #include <boost/make_shared.hpp>
+#include <boost/ref.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <stdlib.h>
 #include <algorithm>
+#include <fstream>
 #include <iterator>
 #include <iostream>
+#include <unistd.h>
 
 //-------------------------------
 // Collaborating Class Headers --
 //-------------------------------
+#include "psana/EventIter.h"
+#include "psana/EventJoin.h"
 #include "psana/EventLoop.h"
+#include "psana/Exceptions.h"
 #include "psana/InputModule.h"
+#include "psana/TypedModule.h"
 #include "PSEnv/Env.h"
+#include "PSEvt/EventId.h"
 
 using namespace psana ;
 
@@ -56,20 +67,518 @@ public:
   
   virtual void endJob(Event& evt, Env& env) {}
 
-private:
+  virtual bool updatesEnv() const { return false; }
+
+protected:
   
   std::deque<psana::InputModule::Status> m_states;  
 };
 
+// Input module which reads events in two steps and counts payload reads
+class TwoPhaseInputModule: public TestInputModule {
+public:
+
+  TwoPhaseInputModule(const InputModule::Status states[], int nstates)
+    : TestInputModule(states, nstates), nPayload(0), nTransition(0), m_last(Stop) {}
+
+  virtual Status eventHeader(Event& evt, Env& env) {
+    return m_last = TestInputModule::event(evt, env);
+  }
+
+  virtual void eventPayload(Event& evt, Env& env) {
+    if (m_last == DoEvent) {
+      ++ nPayload;
+      evt.put(boost::make_shared<int>(nPayload), "payload");
+    } else {
+      ++ nTransition;
+    }
+  }
+
+  virtual Status event(Event& evt, Env& env) {
+    Status stat = eventHeader(evt, env);
+    if (stat != Skip and stat != Stop and stat != Abort) eventPayload(evt, env);
+    return stat;
+  }
+
+  int nPayload;
+  int nTransition;
+private:
+  Status m_last;
+};
+
+// Input module which can skip events without reading them
+class SeekingInputModule: public TestInputModule {
+public:
+
+  SeekingInputModule(const InputModule::Status states[], int nstates)
+    : TestInputModule(states, nstates), nEvent(0), nSeek(0) {}
+
+  virtual Status event(Event& evt, Env& env) {
+    Status stat = TestInputModule::event(evt, env);
+    if (stat == DoEvent) ++ nEvent;
+    return stat;
+  }
+
+  virtual bool skipToTransition(Env& env) {
+    ++ nSeek;
+    while (not m_states.empty() and m_states.front() == DoEvent) m_states.pop_front();
+    return true;
+  }
+
+  int nEvent;
+  int nSeek;
+};
+
+// Input module with index, event number n has time 1000+n seconds
+class WindowInputModule: public TestInputModule, public Index {
+public:
+
+  WindowInputModule(const InputModule::Status states[], int nstates)
+    : TestInputModule(states, nstates), nSelect(0), m_runs() {}
+
+  virtual Index& index() { return *this; }
+
+  // drops events of current run outside of the window
+  virtual int select(EventTime t0, EventTime t1) {
+    ++ nSelect;
+    unsigned n = 0;
+    std::deque<InputModule::Status> states;
+    for (std::deque<InputModule::Status>::iterator it = m_states.begin(); it != m_states.end(); ++ it) {
+      if (*it == EndRun) {
+        states.insert(states.end(), it, m_states.end());
+        break;
+      }
+      if (*it == DoEvent) {
+        const uint32_t sec = 1000 + ++ n;
+        if (sec < t0.seconds() or sec >= t1.seconds()) continue;
+      }
+      states.push_back(*it);
+    }
+    m_states.swap(states);
+    return 0;
+  }
+
+  virtual int jump(EventTime t) { return -1; }
+  virtual void setrun(int run) {}
+  virtual void end() {}
+  virtual unsigned nsteps() { return 0; }
+  virtual void times(EventTimeIter& begin, EventTimeIter& end) {}
+  virtual void times(unsigned step, EventTimeIter& begin, EventTimeIter& end) {}
+  virtual const std::vector<unsigned>& runs() { return m_runs; }
+
+  int nSelect;
+private:
+  std::vector<unsigned> m_runs;
+};
+
+// Input module which reports its position and can jump back to it
+class RestartableInputModule: public TestInputModule, public RandomAccess {
+public:
+
+  RestartableInputModule(const InputModule::Status states[], int nstates)
+    : TestInputModule(states, nstates), nJump(0), m_nstates(nstates), m_run(0) {}
+
+  virtual Status event(Event& evt, Env& env) {
+    Status stat = TestInputModule::event(evt, env);
+    if (stat == BeginRun) ++ m_run;
+    return stat;
+  }
+
+  virtual bool resumePosition(int& run, std::vector<std::string>& filenames,
+      std::vector<int64_t>& offsets, std::string& lastBeginCalibCycleDgram) {
+    run = m_run;
+    filenames.assign(1, "test.xtc");
+    offsets.assign(1, m_nstates - m_states.size());
+    return true;
+  }
+
+  virtual RandomAccess& randomAccess() { return *this; }
+
+  // drops states up to the offset, run transition is repeated like in real data
+  virtual int jump(const std::vector<std::string>& filenames, const std::vector<int64_t> &offsets,
+      const std::string &lastBeginCalibCycleDgram, uintptr_t runtime, uintptr_t ctx) {
+    ++ nJump;
+    m_states.erase(m_states.begin(), m_states.begin() + offsets[0]);
+    m_states.push_front(BeginRun);
+    return 0;
+  }
+
+  virtual void setrun(int run) { m_run = run - 1; }
+
+  int nJump;
+private:
+  int m_nstates;
+  int m_run;
+};
+
+// Input module which pretends that all remaining events are available in live mode
+class LiveInputModule: public TestInputModule {
+public:
+
+  LiveInputModule(const InputModule::Status states[], int nstates)
+    : TestInputModule(states, nstates), m_avail(std::count(states, states+nstates, DoEvent)) {}
+
+  virtual Status event(Event& evt, Env& env) {
+    Status stat = TestInputModule::event(evt, env);
+    if (stat == DoEvent) -- m_avail;
+    return stat;
+  }
+
+  virtual bool liveAvail(int numEvents) { return m_avail > numEvents; }
+
+private:
+  int m_avail;
+};
+
+// User module which counts calls of its methods
+class CountingModule: public Module {
+public:
+
+  CountingModule() : Module("CountingModule"), nBeginRun(0), nEvent(0), nEndJob(0) {}
+
+  virtual void beginRun(Event& evt, Env& env) { ++ nBeginRun; }
+  virtual void event(Event& evt, Env& env) { ++ nEvent; }
+  virtual void endJob(Event& evt, Env& env) { ++ nEndJob; }
+
+  int nBeginRun;
+  int nEvent;
+  int nEndJob;
+};
+
+// Counters shared between copies of the ClonableModule
+struct SharedCounts {
+  SharedCounts() : nBeginRun(0), nEvent(0) {}
+  int incr(int& counter) { boost::lock_guard<boost::mutex> lock(mutex); return ++ counter; }
+  int nBeginRun;
+  int nEvent;
+  boost::mutex mutex;
+};
+
+// User module which supports cloning, all copies update the same counters,
+// optionally requests stop when total number of events reaches given value
+class ClonableModule: public Module {
+public:
+
+  ClonableModule(const boost::shared_ptr<SharedCounts>& counts, int stopAt = 0)
+    : Module("ClonableModule"), m_counts(counts), m_stopAt(stopAt) {}
+
+  virtual Module* clone() const { return new ClonableModule(m_counts, m_stopAt); }
+
+  virtual void beginRun(Event& evt, Env& env) { m_counts->incr(m_counts->nBeginRun); }
+  virtual void event(Event& evt, Env& env) { if (m_counts->incr(m_counts->nEvent) == m_stopAt) stop(); }
+
+private:
+  boost::shared_ptr<SharedCounts> m_counts;
+  int m_stopAt;
+};
+
+// Input module which updates environment for every event
+class EnvInputModule: public TestInputModule {
+public:
+
+  EnvInputModule(const InputModule::Status states[], int nstates) : TestInputModule(states, nstates) {}
+
+  virtual bool updatesEnv() const { return true; }
+};
+
+// User module which declares its data, counts events and checks that consumed data exist
+class DeclaringModule: public Module {
+public:
+
+  DeclaringModule(const std::string& name, const std::string& consumed, const std::string& produced)
+    : Module(name), m_produced(produced), nEvent(0), nMissing(0), skipAt(0), undeclared()
+  {
+    if (not consumed.empty()) consumes(consumed);
+    if (not produced.empty()) produces(produced);
+  }
+
+  virtual void event(Event& evt, Env& env) {
+    ++ nEvent;
+    const std::vector<std::string>& keys = consumedKeys();
+    for (std::vector<std::string>::const_iterator it = keys.begin(); it != keys.end(); ++ it) {
+      if (not evt.exists<int>(*it)) ++ nMissing;
+    }
+    if (not m_produced.empty()) evt.put(boost::make_shared<int>(nEvent), m_produced);
+    if (not undeclared.empty()) evt.put(boost::make_shared<int>(nEvent), undeclared);
+    if (nEvent == skipAt) skip();
+  }
+
+  // declare that event() may call skip()
+  void filter() { setMayFilter(); }
+
+private:
+  std::string m_produced;
+public:
+  int nEvent;
+  int nMissing;
+  int skipAt;               ///< skip this event
+  std::string undeclared;   ///< add data with this key without declaring it
+};
+
+// User module which skips every other event
+class SkippingModule: public Module {
+public:
+
+  SkippingModule() : Module("SkippingModule"), nEvent(0) {}
+
+  virtual void event(Event& evt, Env& env) { if (++ nEvent % 2 == 0) skip(); }
+
+  int nEvent;
+};
+
+// Tracks number of modules which are in beginRun() at the same time
+struct BeginTracker {
+  BeginTracker() : active(0), maxActive(0) {}
+  void enter(const std::string& name) {
+    boost::lock_guard<boost::mutex> lock(mutex);
+    order.push_back(name);
+    maxActive = std::max(maxActive, ++ active);
+  }
+  void leave() { boost::lock_guard<boost::mutex> lock(mutex); -- active; }
+  int active;
+  int maxActive;
+  std::vector<std::string> order;
+  boost::mutex mutex;
+};
+
+// User module with slow beginRun(), e.g. loading calibrations
+class CalibModule: public Module {
+public:
+
+  CalibModule(const std::string& name, const std::string& consumed, const std::string& produced, BeginTracker& tracker)
+    : Module(name), m_tracker(tracker), m_produced(produced), undeclared()
+  {
+    if (not consumed.empty()) consumes(consumed);
+    if (not produced.empty()) produces(produced);
+  }
+
+  virtual void beginRun(Event& evt, Env& env) {
+    m_tracker.enter(name());
+    usleep(20000);
+    if (not m_produced.empty()) evt.put(boost::make_shared<int>(1), m_produced);
+    if (not undeclared.empty()) evt.put(boost::make_shared<int>(1), undeclared);
+    m_tracker.leave();
+  }
+  virtual void event(Event& evt, Env& env) {}
+
+private:
+  BeginTracker& m_tracker;
+  std::string m_produced;
+public:
+  std::string undeclared;   ///< add data with this key without declaring it
+};
+
+// User module which does nothing, only used to measure framework overhead
+class NoopModule: public Module {
+public:
+
+  NoopModule() : Module("NoopModule") {}
+
+  virtual void event(Event& evt, Env& env) {}
+};
+
+// User module which adds two data items to event, second one only to even events
+class ProducingModule: public Module {
+public:
+
+  ProducingModule() : Module("ProducingModule"), nEvent(0) {}
+
+  virtual void event(Event& evt, Env& env) {
+    ++ nEvent;
+    evt.put(boost::make_shared<int>(nEvent), "count");
+    if (nEvent % 2 == 0) evt.put(boost::make_shared<double>(nEvent / 2.), "half");
+  }
+
+  int nEvent;
+};
+
+// Typed module which reads data added by ProducingModule
+class SummingModule: public TypedModule<int, double> {
+public:
+
+  using TypedModule<int, double>::event;
+
+  SummingModule() : TypedModule<int, double>("SummingModule"), nEvent(0), sum(0) {
+    bindInput(0, PSEvt::Source(), "count");
+    bindInput(1, PSEvt::Source(), "half");
+  }
+
+  virtual void event(const int& count, const double& half, Event& evt, Env& env) {
+    ++ nEvent;
+    sum += count + half;
+  }
+
+  void bind(unsigned index) { bindInput(index, PSEvt::Source(), "bad"); }
+
+  int nEvent;
+  double sum;
+};
+
+// User module which requests stop after given number of events
+class StoppingModule: public Module {
+public:
+
+  StoppingModule(int maxEvents) : Module("StoppingModule"), nEvent(0), m_maxEvents(maxEvents) {}
+
+  virtual void event(Event& evt, Env& env) { if (++ nEvent == m_maxEvents) stop(); }
+
+  int nEvent;
+private:
+  int m_maxEvents;
+};
+
+// User module which observes all events and counts skipped ones
+class ObservingModule: public Module {
+public:
+
+  ObservingModule() : Module("ObservingModule", true), nEvent(0), nSkipped(0), nFlagged(0) {}
+
+  virtual void event(Event& evt, Env& env) {
+    ++ nEvent;
+    if (eventSkipped()) ++ nSkipped;
+    if (evt.exists<int>("__psana_skip_event__")) ++ nFlagged;
+  }
+
+  int nEvent;
+  int nSkipped;
+  int nFlagged;
+};
+
+// User module which processes batches, counts batches and skipped events
+class BatchModule: public Module {
+public:
+
+  BatchModule() : Module("BatchModule"), nEvent(0), nSkipped(0) {}
+
+  virtual void event(Event& evt, Env& env) { ++ nEvent; }
+  virtual void eventBatch(EventBatch& batch, Env& env) {
+    sizes.push_back(batch.size());
+    nSkipped += batch.nSkipped();
+  }
+
+  int nEvent;
+  int nSkipped;
+  std::vector<unsigned> sizes;
+};
+
+// User module which is slow for every other event
+class SlowModule: public Module {
+public:
+
+  SlowModule() : Module("SlowModule"), nEvent(0) {}
+
+  virtual void event(Event& evt, Env& env) { if (++ nEvent % 2 == 0) usleep(10000); }
+
+  int nEvent;
+};
+
+// Event id with time which is given by event number
+class TestEventId: public PSEvt::EventId {
+public:
+
+  TestEventId(unsigned n, unsigned nsec = 0) : m_n(n), m_nsec(nsec) {}
+
+  virtual PSTime::Time time() const { return PSTime::Time(1000 + m_n, m_nsec); }
+  virtual int run() const { return 1; }
+  virtual unsigned fiducials() const { return 3 * m_n; }
+  virtual unsigned ticks() const { return 0; }
+  virtual unsigned vector() const { return m_n; }
+  virtual unsigned control() const { return 0; }
+  virtual bool operator==(const EventId& other) const { return fiducials() == other.fiducials(); }
+  virtual bool operator<(const EventId& other) const { return fiducials() < other.fiducials(); }
+  virtual void print(std::ostream& os) const { os << "TestEventId(" << m_n << ")"; }
+
+private:
+  unsigned m_n;
+  unsigned m_nsec;
+};
+
+// User module which keeps number of events in checkpoint
+class CheckpointModule: public Module {
+public:
+
+  CheckpointModule() : Module("CheckpointModule"), nEvent(0), total(0) {}
+
+  virtual void event(Event& evt, Env& env) { ++ nEvent; ++ total; }
+  virtual void saveCheckpoint(std::ostream& out) const { out << total; }
+  virtual void loadCheckpoint(std::istream& in) { in >> total; }
+
+  int nEvent;
+  int total;
+};
+
+// User module which adds event id to every event, event numbers start with first
+class EventIdModule: public Module {
+public:
+
+  EventIdModule(unsigned first = 1, unsigned step = 1, unsigned nsec = 0)
+    : Module("EventIdModule"), m_n(first), m_step(step), m_nsec(nsec) {}
+
+  virtual void event(Event& evt, Env& env) {
+    evt.put(boost::make_shared<TestEventId>(m_n, m_nsec));
+    m_n += m_step;
+  }
+
+private:
+  unsigned m_n;
+  unsigned m_step;
+  unsigned m_nsec;
+};
+
+// Cacheable module which computes square of event number and skips odd events
+class SquareModule: public Module {
+public:
+
+  SquareModule() : Module("SquareModule"), nEvent(0) { setCacheable(); }
+
+  virtual void event(Event& evt, Env& env) {
+    ++ nEvent;
+    boost::shared_ptr<PSEvt::EventId> eid = evt.get();
+    const int n = eid->vector();
+    evt.put(boost::make_shared<int>(n * n), "square");
+    if (n % 2) skip();
+  }
+
+  virtual void saveProducts(Event& evt, std::ostream& out) const {
+    boost::shared_ptr<int> square = evt.get("square");
+    out << *square;
+  }
+
+  virtual void loadProducts(Event& evt, std::istream& in) {
+    int square = 0;
+    in >> square;
+    evt.put(boost::make_shared<int>(square), "square");
+  }
+
+  int nEvent;
+};
+
+// User module which sums data added by SquareModule
+class SquareSumModule: public Module {
+public:
+
+  SquareSumModule() : Module("SquareSumModule"), nEvent(0), sum(0) {}
+
+  virtual void event(Event& evt, Env& env) {
+    ++ nEvent;
+    boost::shared_ptr<int> square = evt.get("square");
+    if (square) sum += *square;
+  }
+
+  int nEvent;
+  int sum;
+};
+
 struct Fixture {
   
-  Fixture(const InputModule::Status states[], int nstates) 
+  Fixture(const InputModule::Status states[], int nstates,
+      const std::vector<boost::shared_ptr<Module> >& modules = std::vector<boost::shared_ptr<Module> >(),
+      boost::shared_ptr<InputModule> input = boost::shared_ptr<InputModule>())
   {
     boost::shared_ptr<AliasMap> amap = boost::make_shared<AliasMap>();
     boost::shared_ptr<PSEnv::IExpNameProvider> expNameProvider;
     boost::shared_ptr<PSEnv::Env> env = boost::make_shared<PSEnv::Env>("", expNameProvider, "", amap, 0);
-    boost::shared_ptr<InputModule> input = boost::make_shared<TestInputModule>(states, nstates);
-    const std::vector<boost::shared_ptr<Module> > modules;
+    if (not input) input = boost::make_shared<TestInputModule>(states, nstates);
     evtLoop = boost::make_shared<EventLoop>(input, modules, env);
   }
   
@@ -191,3 +700,1045 @@ BOOST_AUTO_TEST_CASE( test_2 )
 
 // ==============================================================
 
+BOOST_AUTO_TEST_CASE( test_skip )
+{
+  std::vector<InputModule::Status> states;
+  states.push_back(InputModule::BeginRun);
+  states.push_back(InputModule::BeginCalibCycle);
+  states.insert(states.end(), 10, InputModule::DoEvent);
+  states.push_back(InputModule::EndCalibCycle);
+  states.push_back(InputModule::EndRun);
+
+  // modules after skipping one do not see skipped events, observer
+  // sees them and finds special key in the event, same in batch mode
+  for (unsigned batchSize = 1; batchSize <= 4; batchSize += 3) {
+    boost::shared_ptr<SkippingModule> modS = boost::make_shared<SkippingModule>();
+    boost::shared_ptr<CountingModule> modC = boost::make_shared<CountingModule>();
+    boost::shared_ptr<ObservingModule> modO = boost::make_shared<ObservingModule>();
+    std::vector<boost::shared_ptr<Module> > modules;
+    modules.push_back(modS);
+    modules.push_back(modC);
+    modules.push_back(modO);
+    Fixture f(&states[0], states.size(), modules);
+    f.evtLoop->setBatchSize(batchSize);
+
+    int nEvents = 0;
+    EventLoop::value_type val;
+    while ((val = f.evtLoop->next()).first != EventLoop::None) {
+      if (val.first == EventLoop::Event) ++ nEvents;
+    }
+    BOOST_CHECK_EQUAL(nEvents, 10);
+    BOOST_CHECK_EQUAL(modS->nEvent, 10);
+    BOOST_CHECK_EQUAL(modC->nEvent, 5);
+    BOOST_CHECK_EQUAL(modO->nEvent, 10);
+    BOOST_CHECK_EQUAL(modO->nSkipped, 5);
+    BOOST_CHECK_EQUAL(modO->nFlagged, 5);
+  }
+
+  // without observers key is only added to returned events, unless disabled
+  for (int key = 0; key != 4; ++ key) {
+    std::vector<boost::shared_ptr<Module> > modules(1, boost::make_shared<SkippingModule>());
+    modules.push_back(boost::make_shared<CountingModule>());
+    Fixture f(&states[0], states.size(), modules);
+    f.evtLoop->setBatchSize(key < 2 ? 1 : 4);
+    if (key % 2 == 0) f.evtLoop->setSkipEventKey(false);
+
+    int nFlagged = 0;
+    EventLoop::value_type val;
+    while ((val = f.evtLoop->next()).first != EventLoop::None) {
+      if (val.first == EventLoop::Event and val.second->exists<int>("__psana_skip_event__")) ++ nFlagged;
+    }
+    BOOST_CHECK_EQUAL(nFlagged, key % 2 ? 5 : 0);
+  }
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_profile )
+{
+  InputModule::Status states[] = {
+      InputModule::BeginRun,
+      InputModule::BeginCalibCycle,
+      InputModule::DoEvent,
+      InputModule::DoEvent,
+      InputModule::EndCalibCycle,
+      InputModule::EndRun,
+  };
+
+  boost::shared_ptr<CountingModule> mod = boost::make_shared<CountingModule>();
+  std::vector<boost::shared_ptr<Module> > modules(1, mod);
+  Fixture f(states, sizeof states/sizeof states[0], modules);
+
+  char path[] = "/tmp/EventLoopTest-profile-XXXXXX";
+  int fd = mkstemp(path);
+  BOOST_REQUIRE(fd >= 0);
+  close(fd);
+  f.evtLoop->enableProfiling(path);
+
+  // profiling must not change sequence of events
+  EventLoop::EventType expected[] = { EventLoop::BeginJob, EventLoop::BeginRun, EventLoop::BeginCalibCycle,
+      EventLoop::Event, EventLoop::Event, EventLoop::EndCalibCycle, EventLoop::EndRun, EventLoop::EndJob,
+      EventLoop::None };
+  for (unsigned i = 0; i != sizeof expected/sizeof expected[0]; ++ i) {
+    BOOST_CHECK_EQUAL(f.evtLoop->next().first, expected[i]);
+  }
+  BOOST_CHECK_EQUAL(mod->nBeginRun, 1);
+  BOOST_CHECK_EQUAL(mod->nEvent, 2);
+  BOOST_CHECK_EQUAL(mod->nEndJob, 1);
+
+  // table has a header and one line per transition type which was called
+  std::ifstream in(path);
+  unsigned nlines = 0;
+  for (std::string line; std::getline(in, line); ) ++ nlines;
+#if defined(__GNUC__) && not defined(__clang__)
+  // only methods overridden by module are called for transitions
+  BOOST_CHECK_EQUAL(nlines, 4U);
+#else
+  BOOST_CHECK_EQUAL(nlines, 8U);
+#endif
+  unlink(path);
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_threads )
+{
+  std::vector<InputModule::Status> states;
+  states.push_back(InputModule::BeginRun);
+  states.push_back(InputModule::BeginCalibCycle);
+  states.insert(states.end(), 25, InputModule::DoEvent);
+  states.push_back(InputModule::EndCalibCycle);
+  states.push_back(InputModule::EndRun);
+
+  boost::shared_ptr<SharedCounts> counts = boost::make_shared<SharedCounts>();
+  std::vector<boost::shared_ptr<Module> > modules(1, boost::make_shared<ClonableModule>(counts));
+  Fixture f(&states[0], states.size(), modules);
+  f.evtLoop->setThreads(3);
+
+  // sequence must be the same as in single-threaded mode
+  BOOST_CHECK_EQUAL(f.evtLoop->next().first, EventLoop::BeginJob);
+  BOOST_CHECK_EQUAL(f.evtLoop->next().first, EventLoop::BeginRun);
+  BOOST_CHECK_EQUAL(f.evtLoop->next().first, EventLoop::BeginCalibCycle);
+  for (int i = 0; i != 25; ++ i) {
+    BOOST_CHECK_EQUAL(f.evtLoop->next().first, EventLoop::Event);
+  }
+  BOOST_CHECK_EQUAL(f.evtLoop->next().first, EventLoop::EndCalibCycle);
+  BOOST_CHECK_EQUAL(f.evtLoop->next().first, EventLoop::EndRun);
+  BOOST_CHECK_EQUAL(f.evtLoop->next().first, EventLoop::EndJob);
+  BOOST_CHECK_EQUAL(f.evtLoop->next().first, EventLoop::None);
+
+  // every copy sees transitions, every event is processed once
+  BOOST_CHECK_EQUAL(counts->nBeginRun, 3);
+  BOOST_CHECK_EQUAL(counts->nEvent, 25);
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_threads_stop )
+{
+  std::vector<InputModule::Status> states;
+  states.push_back(InputModule::BeginRun);
+  states.push_back(InputModule::BeginCalibCycle);
+  states.insert(states.end(), 25, InputModule::DoEvent);
+  states.push_back(InputModule::EndCalibCycle);
+  states.push_back(InputModule::EndRun);
+
+  boost::shared_ptr<SharedCounts> counts = boost::make_shared<SharedCounts>();
+  std::vector<boost::shared_ptr<Module> > modules(1, boost::make_shared<ClonableModule>(counts, 5));
+  Fixture f(&states[0], states.size(), modules);
+  f.evtLoop->setThreads(3);
+
+  int nEvents = 0;
+  EventLoop::value_type val;
+  while ((val = f.evtLoop->next()).first != EventLoop::None) {
+    if (val.first == EventLoop::Event) ++ nEvents;
+  }
+
+  // only events before the stopped one are returned, there can be at most
+  // two of them in flight when fifth event stops
+  BOOST_CHECK(nEvents <= 6);
+  BOOST_CHECK(counts->nEvent >= nEvents + 1);
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_threads_env )
+{
+  InputModule::Status states[] = {
+      InputModule::BeginRun,
+      InputModule::BeginCalibCycle,
+      InputModule::DoEvent,
+      InputModule::DoEvent,
+      InputModule::EndCalibCycle,
+      InputModule::EndRun,
+  };
+
+  // input which updates environment is processed in one thread
+  boost::shared_ptr<SharedCounts> counts = boost::make_shared<SharedCounts>();
+  std::vector<boost::shared_ptr<Module> > modules(1, boost::make_shared<ClonableModule>(counts));
+  boost::shared_ptr<InputModule> input = boost::make_shared<EnvInputModule>(states, sizeof states/sizeof states[0]);
+  Fixture f(states, sizeof states/sizeof states[0], modules, input);
+  f.evtLoop->setThreads(3);
+  while (f.evtLoop->next().first != EventLoop::None) {}
+
+  BOOST_CHECK_EQUAL(counts->nBeginRun, 1);
+  BOOST_CHECK_EQUAL(counts->nEvent, 2);
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_module_threads )
+{
+  std::vector<InputModule::Status> states;
+  states.push_back(InputModule::BeginRun);
+  states.push_back(InputModule::BeginCalibCycle);
+  states.insert(states.end(), 10, InputModule::DoEvent);
+  states.push_back(InputModule::EndCalibCycle);
+  states.push_back(InputModule::EndRun);
+
+  // P and B, C are independent, A needs data from P, S is a barrier
+  boost::shared_ptr<DeclaringModule> modP = boost::make_shared<DeclaringModule>("P", "", "x");
+  boost::shared_ptr<DeclaringModule> modA = boost::make_shared<DeclaringModule>("A", "x", "");
+  boost::shared_ptr<DeclaringModule> modB = boost::make_shared<DeclaringModule>("B", "y", "");
+  boost::shared_ptr<DeclaringModule> modC = boost::make_shared<DeclaringModule>("C", "z", "");
+  boost::shared_ptr<SkippingModule> modS = boost::make_shared<SkippingModule>();
+  boost::shared_ptr<DeclaringModule> modD = boost::make_shared<DeclaringModule>("D", "x", "");
+  boost::shared_ptr<ObservingModule> modO = boost::make_shared<ObservingModule>();
+  std::vector<boost::shared_ptr<Module> > modules;
+  modules.push_back(modP);
+  modules.push_back(modA);
+  modules.push_back(modB);
+  modules.push_back(modC);
+  modules.push_back(modS);
+  modules.push_back(modD);
+  modules.push_back(modO);
+  Fixture f(&states[0], states.size(), modules);
+  f.evtLoop->setModuleThreads(4);
+
+  EventLoop::EventType expected[] = { EventLoop::BeginJob, EventLoop::BeginRun, EventLoop::BeginCalibCycle,
+      EventLoop::Event, EventLoop::Event, EventLoop::Event, EventLoop::Event, EventLoop::Event,
+      EventLoop::Event, EventLoop::Event, EventLoop::Event, EventLoop::Event, EventLoop::Event,
+      EventLoop::EndCalibCycle, EventLoop::EndRun, EventLoop::EndJob, EventLoop::None };
+  for (unsigned i = 0; i != sizeof expected/sizeof expected[0]; ++ i) {
+    BOOST_CHECK_EQUAL(f.evtLoop->next().first, expected[i]);
+  }
+
+  BOOST_CHECK_EQUAL(modP->nEvent, 10);
+  BOOST_CHECK_EQUAL(modA->nEvent, 10);
+  BOOST_CHECK_EQUAL(modA->nMissing, 0);
+  BOOST_CHECK_EQUAL(modB->nEvent, 10);
+  BOOST_CHECK_EQUAL(modC->nEvent, 10);
+  BOOST_CHECK_EQUAL(modS->nEvent, 10);
+
+  // modules after barrier do not see skipped events
+  BOOST_CHECK_EQUAL(modD->nEvent, 5);
+  BOOST_CHECK_EQUAL(modD->nMissing, 0);
+
+  // skipped events are still seen by observer
+  BOOST_CHECK_EQUAL(modO->nEvent, 10);
+  BOOST_CHECK_EQUAL(modO->nSkipped, 5);
+  BOOST_CHECK_EQUAL(modO->nFlagged, 5);
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_module_threads_errors )
+{
+  InputModule::Status states[] = {
+      InputModule::BeginRun,
+      InputModule::BeginCalibCycle,
+      InputModule::DoEvent,
+      InputModule::DoEvent,
+      InputModule::DoEvent,
+      InputModule::EndCalibCycle,
+      InputModule::EndRun,
+  };
+
+  // skip from a module which precedes its step-mate cannot be respected
+  {
+    boost::shared_ptr<DeclaringModule> modB = boost::make_shared<DeclaringModule>("B", "y", "");
+    boost::shared_ptr<DeclaringModule> modC = boost::make_shared<DeclaringModule>("C", "z", "");
+    modB->skipAt = 2;
+    std::vector<boost::shared_ptr<Module> > modules;
+    modules.push_back(modB);
+    modules.push_back(modC);
+    Fixture f(states, sizeof states/sizeof states[0], modules);
+    f.evtLoop->setModuleThreads(2);
+    for (int i = 0; i != 4; ++ i) f.evtLoop->next();
+    BOOST_CHECK_THROW(f.evtLoop->next(), ExceptionAbort);
+  }
+
+  // skip from the last module of the step is the same as in sequential mode
+  {
+    boost::shared_ptr<DeclaringModule> modB = boost::make_shared<DeclaringModule>("B", "y", "");
+    boost::shared_ptr<DeclaringModule> modC = boost::make_shared<DeclaringModule>("C", "z", "");
+    modC->skipAt = 2;
+    std::vector<boost::shared_ptr<Module> > modules;
+    modules.push_back(modB);
+    modules.push_back(modC);
+    Fixture f(states, sizeof states/sizeof states[0], modules);
+    f.evtLoop->setModuleThreads(2);
+    while (f.evtLoop->next().first != EventLoop::None) {}
+    BOOST_CHECK_EQUAL(modB->nEvent, 3);
+  }
+
+  // declared filter runs in its own step, following module does not see skipped event
+  {
+    boost::shared_ptr<DeclaringModule> modB = boost::make_shared<DeclaringModule>("B", "y", "");
+    boost::shared_ptr<DeclaringModule> modC = boost::make_shared<DeclaringModule>("C", "z", "");
+    modB->skipAt = 2;
+    modB->filter();
+    std::vector<boost::shared_ptr<Module> > modules;
+    modules.push_back(modB);
+    modules.push_back(modC);
+    Fixture f(states, sizeof states/sizeof states[0], modules);
+    f.evtLoop->setModuleThreads(2);
+    while (f.evtLoop->next().first != EventLoop::None) {}
+    BOOST_CHECK_EQUAL(modB->nEvent, 3);
+    BOOST_CHECK_EQUAL(modC->nEvent, 2);
+  }
+
+  // undeclared data added by parallel module
+  {
+    boost::shared_ptr<DeclaringModule> modB = boost::make_shared<DeclaringModule>("B", "y", "");
+    boost::shared_ptr<DeclaringModule> modC = boost::make_shared<DeclaringModule>("C", "z", "");
+    modC->undeclared = "w";
+    std::vector<boost::shared_ptr<Module> > modules;
+    modules.push_back(modB);
+    modules.push_back(modC);
+    Fixture f(states, sizeof states/sizeof states[0], modules);
+    f.evtLoop->setModuleThreads(2);
+    for (int i = 0; i != 3; ++ i) f.evtLoop->next();
+    BOOST_CHECK_THROW(f.evtLoop->next(), ExceptionAbort);
+  }
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_batch )
+{
+  std::vector<InputModule::Status> states;
+  states.push_back(InputModule::BeginRun);
+  states.push_back(InputModule::BeginCalibCycle);
+  states.insert(states.end(), 10, InputModule::DoEvent);
+  states.push_back(InputModule::EndCalibCycle);
+  states.push_back(InputModule::BeginCalibCycle);
+  states.insert(states.end(), 3, InputModule::DoEvent);
+  states.push_back(InputModule::EndCalibCycle);
+  states.push_back(InputModule::EndRun);
+
+  // S uses default per-event calls, B gets whole batches
+  boost::shared_ptr<SkippingModule> modS = boost::make_shared<SkippingModule>();
+  boost::shared_ptr<BatchModule> modB = boost::make_shared<BatchModule>();
+  std::vector<boost::shared_ptr<Module> > modules;
+  modules.push_back(modS);
+  modules.push_back(modB);
+  Fixture f(&states[0], states.size(), modules);
+  f.evtLoop->setBatchSize(4);
+
+  // batches do not cross calib cycle boundary
+  EventLoop::EventType expected[] = { EventLoop::BeginJob, EventLoop::BeginRun, EventLoop::BeginCalibCycle,
+      EventLoop::Event, EventLoop::Event, EventLoop::Event, EventLoop::EndCalibCycle,
+      EventLoop::BeginCalibCycle, EventLoop::Event, EventLoop::EndCalibCycle,
+      EventLoop::EndRun, EventLoop::EndJob, EventLoop::None };
+  unsigned expectedSizes[] = { 1, 1, 1, 4, 4, 2, 1, 1, 3, 1, 1, 1, 0 };
+  for (unsigned i = 0; i != sizeof expected/sizeof expected[0]; ++ i) {
+    std::vector<EventLoop::EventPtr> events;
+    BOOST_CHECK_EQUAL(f.evtLoop->nextBatch(events), expected[i]);
+    BOOST_CHECK_EQUAL(events.size(), expectedSizes[i]);
+  }
+
+  BOOST_CHECK_EQUAL(modS->nEvent, 13);
+  BOOST_CHECK_EQUAL(modB->nEvent, 0);
+  BOOST_REQUIRE_EQUAL(modB->sizes.size(), 4U);
+  BOOST_CHECK_EQUAL(modB->sizes[0], 4U);
+  BOOST_CHECK_EQUAL(modB->sizes[1], 4U);
+  BOOST_CHECK_EQUAL(modB->sizes[2], 2U);
+  BOOST_CHECK_EQUAL(modB->sizes[3], 3U);
+  BOOST_CHECK_EQUAL(modB->nSkipped, 6);
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_batch_env )
+{
+  InputModule::Status states[] = {
+      InputModule::BeginRun,
+      InputModule::BeginCalibCycle,
+      InputModule::DoEvent,
+      InputModule::DoEvent,
+      InputModule::DoEvent,
+      InputModule::EndCalibCycle,
+      InputModule::EndRun,
+  };
+
+  // input updates environment and S does not process batches, events are passed one by one
+  {
+    boost::shared_ptr<SkippingModule> modS = boost::make_shared<SkippingModule>();
+    boost::shared_ptr<BatchModule> modB = boost::make_shared<BatchModule>();
+    std::vector<boost::shared_ptr<Module> > modules;
+    modules.push_back(modS);
+    modules.push_back(modB);
+    boost::shared_ptr<InputModule> input = boost::make_shared<EnvInputModule>(states, sizeof states/sizeof states[0]);
+    Fixture f(states, sizeof states/sizeof states[0], modules, input);
+    f.evtLoop->setBatchSize(4);
+    while (f.evtLoop->next().first != EventLoop::None) {}
+    BOOST_CHECK_EQUAL(modS->nEvent, 3);
+    BOOST_CHECK_EQUAL(modB->nEvent, 2);
+    BOOST_CHECK(modB->sizes.empty());
+  }
+
+  // all modules process batches themselves
+  {
+    boost::shared_ptr<BatchModule> modB = boost::make_shared<BatchModule>();
+    std::vector<boost::shared_ptr<Module> > modules(1, modB);
+    boost::shared_ptr<InputModule> input = boost::make_shared<EnvInputModule>(states, sizeof states/sizeof states[0]);
+    Fixture f(states, sizeof states/sizeof states[0], modules, input);
+    f.evtLoop->setBatchSize(4);
+    while (f.evtLoop->next().first != EventLoop::None) {}
+    BOOST_REQUIRE_EQUAL(modB->sizes.size(), 1U);
+    BOOST_CHECK_EQUAL(modB->sizes[0], 3U);
+  }
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_early_filters )
+{
+  std::vector<InputModule::Status> states;
+  states.push_back(InputModule::BeginRun);
+  states.push_back(InputModule::BeginCalibCycle);
+  states.insert(states.end(), 10, InputModule::DoEvent);
+  states.push_back(InputModule::EndCalibCycle);
+  states.push_back(InputModule::EndRun);
+
+  boost::shared_ptr<TwoPhaseInputModule> input = boost::make_shared<TwoPhaseInputModule>(&states[0], states.size());
+  boost::shared_ptr<DeclaringModule> mod = boost::make_shared<DeclaringModule>("M", "payload", "");
+  std::vector<boost::shared_ptr<Module> > modules(1, mod);
+  Fixture f(&states[0], states.size(), modules, input);
+
+  boost::shared_ptr<SkippingModule> filter = boost::make_shared<SkippingModule>();
+  f.evtLoop->setEarlyFilters(std::vector<boost::shared_ptr<Module> >(1, filter));
+
+  // rejected events are not returned
+  EventLoop::EventType expected[] = { EventLoop::BeginJob, EventLoop::BeginRun, EventLoop::BeginCalibCycle,
+      EventLoop::Event, EventLoop::Event, EventLoop::Event, EventLoop::Event, EventLoop::Event,
+      EventLoop::EndCalibCycle, EventLoop::EndRun, EventLoop::EndJob, EventLoop::None };
+  for (unsigned i = 0; i != sizeof expected/sizeof expected[0]; ++ i) {
+    BOOST_CHECK_EQUAL(f.evtLoop->next().first, expected[i]);
+  }
+
+  // payload is only read for accepted events
+  BOOST_CHECK_EQUAL(filter->nEvent, 10);
+  BOOST_CHECK_EQUAL(input->nPayload, 5);
+  BOOST_CHECK_EQUAL(input->nTransition, 4);
+  BOOST_CHECK_EQUAL(mod->nEvent, 5);
+  BOOST_CHECK_EQUAL(mod->nMissing, 0);
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_time_budget )
+{
+  std::vector<InputModule::Status> states;
+  states.push_back(InputModule::BeginRun);
+  states.push_back(InputModule::BeginCalibCycle);
+  states.insert(states.end(), 6, InputModule::DoEvent);
+  states.push_back(InputModule::EndCalibCycle);
+  states.push_back(InputModule::EndRun);
+
+  boost::shared_ptr<SlowModule> slow = boost::make_shared<SlowModule>();
+  boost::shared_ptr<CountingModule> counter = boost::make_shared<CountingModule>();
+  boost::shared_ptr<ObservingModule> observer = boost::make_shared<ObservingModule>();
+  std::vector<boost::shared_ptr<Module> > modules;
+  modules.push_back(slow);
+  modules.push_back(counter);
+  modules.push_back(observer);
+  Fixture f(&states[0], states.size(), modules);
+  f.evtLoop->setTimeBudget(2., 0.);
+
+  while (f.evtLoop->next().first != EventLoop::None) {}
+
+  // slow events are skipped by downstream modules
+  BOOST_CHECK_EQUAL(slow->nEvent, 6);
+  BOOST_CHECK_EQUAL(counter->nEvent, 3);
+  BOOST_CHECK_EQUAL(observer->nEvent, 6);
+  BOOST_CHECK_EQUAL(observer->nSkipped, 3);
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_live_max_lag )
+{
+  std::vector<InputModule::Status> states;
+  states.push_back(InputModule::BeginRun);
+  states.push_back(InputModule::BeginCalibCycle);
+  states.insert(states.end(), 10, InputModule::DoEvent);
+  states.push_back(InputModule::EndCalibCycle);
+  states.push_back(InputModule::EndRun);
+
+  boost::shared_ptr<InputModule> input = boost::make_shared<LiveInputModule>(&states[0], states.size());
+  boost::shared_ptr<CountingModule> counter = boost::make_shared<CountingModule>();
+  Fixture f(&states[0], states.size(), std::vector<boost::shared_ptr<Module> >(1, counter), input);
+  f.evtLoop->setLiveMaxLag(3);
+
+  // events are dropped until at most 3 events are left behind
+  EventLoop::value_type evt;
+  unsigned nEvents = 0;
+  while ((evt = f.evtLoop->next()).first != EventLoop::EndRun) {
+    if (evt.first == EventLoop::Event) ++ nEvents;
+  }
+  BOOST_CHECK_EQUAL(nEvents, 4U);
+  BOOST_CHECK_EQUAL(counter->nEvent, 4);
+
+  // counter is reset after EndRun
+  BOOST_CHECK_EQUAL(f.evtLoop->liveDropped(), 0U);
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_chains )
+{
+  std::vector<InputModule::Status> states;
+  states.push_back(InputModule::BeginRun);
+  states.push_back(InputModule::BeginCalibCycle);
+  states.insert(states.end(), 10, InputModule::DoEvent);
+  states.push_back(InputModule::EndCalibCycle);
+  states.push_back(InputModule::EndRun);
+
+  // regular modules skip every other event
+  std::vector<boost::shared_ptr<Module> > modules;
+  modules.push_back(boost::make_shared<SkippingModule>());
+  boost::shared_ptr<CountingModule> counter = boost::make_shared<CountingModule>();
+  modules.push_back(counter);
+  Fixture f(&states[0], states.size(), modules);
+
+  // this chain sees all events and none of them is skipped
+  boost::shared_ptr<ObservingModule> observer = boost::make_shared<ObservingModule>();
+  f.evtLoop->addChain("observe", std::vector<boost::shared_ptr<Module> >(1, observer));
+
+  // this chain stops after three events
+  std::vector<boost::shared_ptr<Module> > stopModules;
+  stopModules.push_back(boost::make_shared<StoppingModule>(3));
+  boost::shared_ptr<CountingModule> stopCounter = boost::make_shared<CountingModule>();
+  stopModules.push_back(stopCounter);
+  f.evtLoop->addChain("stop", stopModules);
+
+  // returned events keep skip state of regular modules
+  f.evtLoop->setSkipEventKey(true);
+  EventLoop::value_type evt;
+  unsigned nEvents = 0, nFlagged = 0;
+  while ((evt = f.evtLoop->next()).first != EventLoop::None) {
+    if (evt.first != EventLoop::Event) continue;
+    ++ nEvents;
+    if (evt.second->exists<int>("__psana_skip_event__")) ++ nFlagged;
+  }
+  BOOST_CHECK_EQUAL(nEvents, 10U);
+  BOOST_CHECK_EQUAL(nFlagged, 5U);
+  BOOST_CHECK_EQUAL(counter->nEvent, 5);
+
+  BOOST_CHECK_EQUAL(observer->nEvent, 10);
+  BOOST_CHECK_EQUAL(observer->nSkipped, 0);
+  BOOST_CHECK_EQUAL(observer->nFlagged, 0);
+
+  // stopped chain still sees transitions
+  BOOST_CHECK_EQUAL(stopCounter->nEvent, 2);
+  BOOST_CHECK_EQUAL(stopCounter->nEndJob, 1);
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_chains_stop )
+{
+  std::vector<InputModule::Status> states;
+  states.push_back(InputModule::BeginRun);
+  states.push_back(InputModule::BeginCalibCycle);
+  states.insert(states.end(), 10, InputModule::DoEvent);
+  states.push_back(InputModule::EndCalibCycle);
+  states.push_back(InputModule::EndRun);
+
+  // regular modules stop early but other chain still gets events
+  boost::shared_ptr<StoppingModule> stopper = boost::make_shared<StoppingModule>(2);
+  Fixture f(&states[0], states.size(), std::vector<boost::shared_ptr<Module> >(1, stopper));
+  boost::shared_ptr<StoppingModule> other = boost::make_shared<StoppingModule>(6);
+  f.evtLoop->addChain("other", std::vector<boost::shared_ptr<Module> >(1, other));
+
+  EventLoop::value_type evt;
+  unsigned nEvents = 0;
+  while ((evt = f.evtLoop->next()).first != EventLoop::None) {
+    if (evt.first == EventLoop::Event) ++ nEvents;
+  }
+  BOOST_CHECK_EQUAL(nEvents, 1U);
+  BOOST_CHECK_EQUAL(stopper->nEvent, 2);
+  BOOST_CHECK_EQUAL(other->nEvent, 6);
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_chains_products )
+{
+  std::vector<InputModule::Status> states;
+  states.push_back(InputModule::BeginRun);
+  states.push_back(InputModule::BeginCalibCycle);
+  states.insert(states.end(), 4, InputModule::DoEvent);
+  states.push_back(InputModule::EndCalibCycle);
+  states.push_back(InputModule::EndRun);
+
+  // regular module product is seen by all chains
+  boost::shared_ptr<DeclaringModule> regular = boost::make_shared<DeclaringModule>("regular", "", "a");
+  Fixture f(&states[0], states.size(), std::vector<boost::shared_ptr<Module> >(1, regular));
+
+  // both chains produce the same key, second chain does not see product of the first
+  boost::shared_ptr<DeclaringModule> first = boost::make_shared<DeclaringModule>("first", "a", "b");
+  f.evtLoop->addChain("first", std::vector<boost::shared_ptr<Module> >(1, first));
+  boost::shared_ptr<DeclaringModule> second = boost::make_shared<DeclaringModule>("second", "b", "b");
+  f.evtLoop->addChain("second", std::vector<boost::shared_ptr<Module> >(1, second));
+
+  // name must be unique and keys of regular modules cannot be produced
+  BOOST_CHECK_THROW(f.evtLoop->addChain("first", std::vector<boost::shared_ptr<Module> >()), ExceptionAbort);
+  boost::shared_ptr<DeclaringModule> clash = boost::make_shared<DeclaringModule>("clash", "", "a");
+  BOOST_CHECK_THROW(f.evtLoop->addChain("clash", std::vector<boost::shared_ptr<Module> >(1, clash)), ExceptionAbort);
+
+  EventLoop::value_type evt;
+  unsigned nEvents = 0, nChainData = 0;
+  while ((evt = f.evtLoop->next()).first != EventLoop::None) {
+    if (evt.first != EventLoop::Event) continue;
+    ++ nEvents;
+    BOOST_CHECK(evt.second->exists<int>("a"));
+    if (evt.second->exists<int>("b")) ++ nChainData;
+  }
+  BOOST_CHECK_EQUAL(nEvents, 4U);
+  BOOST_CHECK_EQUAL(nChainData, 0U);
+  BOOST_CHECK_EQUAL(first->nEvent, 4);
+  BOOST_CHECK_EQUAL(first->nMissing, 0);
+  BOOST_CHECK_EQUAL(second->nEvent, 4);
+  BOOST_CHECK_EQUAL(second->nMissing, 4);
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_next_transition )
+{
+  std::vector<InputModule::Status> states;
+  states.push_back(InputModule::BeginRun);
+  for (int i = 0; i != 3; ++ i) {
+    states.push_back(InputModule::BeginCalibCycle);
+    states.insert(states.end(), 5, InputModule::DoEvent);
+    states.push_back(InputModule::EndCalibCycle);
+  }
+  states.push_back(InputModule::EndRun);
+
+  // input module without seek support, events are read but not given to modules
+  {
+    boost::shared_ptr<TwoPhaseInputModule> input = boost::make_shared<TwoPhaseInputModule>(&states[0], states.size());
+    boost::shared_ptr<CountingModule> counter = boost::make_shared<CountingModule>();
+    Fixture f(&states[0], states.size(), std::vector<boost::shared_ptr<Module> >(1, counter), input);
+
+    EventLoop::EventType expected[] = { EventLoop::BeginJob, EventLoop::BeginRun, EventLoop::BeginCalibCycle,
+        EventLoop::EndCalibCycle, EventLoop::BeginCalibCycle, EventLoop::EndCalibCycle,
+        EventLoop::BeginCalibCycle, EventLoop::EndCalibCycle, EventLoop::EndRun, EventLoop::EndJob, EventLoop::None };
+    for (unsigned i = 0; i != sizeof expected/sizeof expected[0]; ++ i) {
+      BOOST_CHECK_EQUAL(f.evtLoop->nextTransition().first, expected[i]);
+    }
+    BOOST_CHECK_EQUAL(counter->nEvent, 0);
+    BOOST_CHECK_EQUAL(input->nPayload, 0);
+    BOOST_CHECK_EQUAL(input->nTransition, 8);
+  }
+
+  // input module which can seek, events after the first one are never read
+  {
+    boost::shared_ptr<SeekingInputModule> input = boost::make_shared<SeekingInputModule>(&states[0], states.size());
+    boost::shared_ptr<CountingModule> counter = boost::make_shared<CountingModule>();
+    Fixture f(&states[0], states.size(), std::vector<boost::shared_ptr<Module> >(1, counter), input);
+
+    EventLoop::value_type evt;
+    while ((evt = f.evtLoop->next()).first != EventLoop::Event) {}
+    BOOST_CHECK_EQUAL(f.evtLoop->nextTransition().first, EventLoop::EndCalibCycle);
+    BOOST_CHECK_EQUAL(f.evtLoop->nextTransition().first, EventLoop::BeginCalibCycle);
+    BOOST_CHECK_EQUAL(f.evtLoop->next().first, EventLoop::Event);
+    while ((evt = f.evtLoop->nextTransition()).first != EventLoop::None) {}
+
+    BOOST_CHECK_EQUAL(input->nEvent, 2);
+    BOOST_CHECK_EQUAL(counter->nEvent, 2);
+    BOOST_CHECK_EQUAL(counter->nEndJob, 1);
+  }
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_next_transition_implicit )
+{
+  // input without calib cycle transitions, they are generated by framework
+  {
+    std::vector<InputModule::Status> states;
+    states.push_back(InputModule::BeginRun);
+    states.insert(states.end(), 2, InputModule::DoEvent);
+    states.push_back(InputModule::EndRun);
+
+    boost::shared_ptr<CountingModule> counter = boost::make_shared<CountingModule>();
+    Fixture f(&states[0], states.size(), std::vector<boost::shared_ptr<Module> >(1, counter));
+
+    BOOST_CHECK_EQUAL(f.evtLoop->next().first, EventLoop::BeginJob);
+    EventLoop::EventType expected[] = { EventLoop::BeginRun, EventLoop::BeginCalibCycle,
+        EventLoop::EndCalibCycle, EventLoop::EndRun, EventLoop::EndJob, EventLoop::None };
+    for (unsigned i = 0; i != sizeof expected/sizeof expected[0]; ++ i) {
+      BOOST_CHECK_EQUAL(f.evtLoop->nextTransition().first, expected[i]);
+    }
+  }
+
+  // skipping is not started when transition is already queued, otherwise
+  // the events of the next run would be lost
+  {
+    std::vector<InputModule::Status> states;
+    states.push_back(InputModule::BeginRun);
+    states.push_back(InputModule::BeginCalibCycle);
+    states.insert(states.end(), 2, InputModule::DoEvent);
+    states.push_back(InputModule::EndRun);
+    states.push_back(InputModule::BeginRun);
+    states.push_back(InputModule::BeginCalibCycle);
+    states.insert(states.end(), 2, InputModule::DoEvent);
+    states.push_back(InputModule::EndCalibCycle);
+    states.push_back(InputModule::EndRun);
+
+    boost::shared_ptr<SeekingInputModule> input = boost::make_shared<SeekingInputModule>(&states[0], states.size());
+    Fixture f(&states[0], states.size(), std::vector<boost::shared_ptr<Module> >(), input);
+
+    EventLoop::value_type evt;
+    while ((evt = f.evtLoop->next()).first != EventLoop::Event) {}
+    // EndRun stays queued after EndCalibCycle
+    BOOST_CHECK_EQUAL(f.evtLoop->nextTransition().first, EventLoop::EndCalibCycle);
+    BOOST_CHECK_EQUAL(f.evtLoop->nextTransition().first, EventLoop::EndRun);
+    BOOST_CHECK_EQUAL(input->nSeek, 1);
+
+    unsigned nEvents = 0;
+    while ((evt = f.evtLoop->next()).first != EventLoop::None) {
+      if (evt.first == EventLoop::Event) ++ nEvents;
+    }
+    BOOST_CHECK_EQUAL(nEvents, 2U);
+  }
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_noop_modules )
+{
+  // events handed off through the queues and recycled by the pool reach
+  // every module exactly once; time per event is measured by
+  // EventLoopBenchmark (e.g. -m 20 -P 32)
+  const unsigned nEvents = 100;
+  std::vector<InputModule::Status> states;
+  states.push_back(InputModule::BeginRun);
+  states.push_back(InputModule::BeginCalibCycle);
+  states.insert(states.end(), nEvents, InputModule::DoEvent);
+  states.push_back(InputModule::EndCalibCycle);
+  states.push_back(InputModule::EndRun);
+
+  std::vector<boost::shared_ptr<Module> > modules;
+  for (int i = 0; i != 20; ++ i) modules.push_back(boost::make_shared<NoopModule>());
+  boost::shared_ptr<CountingModule> counter = boost::make_shared<CountingModule>();
+  modules.push_back(counter);
+  Fixture f(&states[0], states.size(), modules);
+  f.evtLoop->setEventPoolSize(32);
+
+  unsigned count = 0;
+  EventLoop::value_type evt;
+  while ((evt = f.evtLoop->next()).first != EventLoop::None) {
+    if (evt.first == EventLoop::Event) ++ count;
+  }
+
+  BOOST_CHECK_EQUAL(count, nEvents);
+  BOOST_CHECK_EQUAL(counter->nEvent, int(nEvents));
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_typed_module )
+{
+  // sources are resolved again in every run
+  std::vector<InputModule::Status> states;
+  for (int i = 0; i != 2; ++ i) {
+    states.push_back(InputModule::BeginRun);
+    states.push_back(InputModule::BeginCalibCycle);
+    states.insert(states.end(), 10, InputModule::DoEvent);
+    states.push_back(InputModule::EndCalibCycle);
+    states.push_back(InputModule::EndRun);
+  }
+
+  std::vector<boost::shared_ptr<Module> > modules;
+  modules.push_back(boost::make_shared<ProducingModule>());
+  boost::shared_ptr<SummingModule> summer = boost::make_shared<SummingModule>();
+  modules.push_back(summer);
+  Fixture f(&states[0], states.size(), modules);
+
+  while (f.evtLoop->next().first != EventLoop::None) {}
+
+  // typed method is only called for events which have both inputs
+  BOOST_CHECK_EQUAL(summer->nEvent, 10);
+  BOOST_CHECK_CLOSE(summer->sum, 30. + 15. + 80. + 40., 1e-9);
+  BOOST_CHECK_EQUAL(summer->inputKey(1), "half");
+
+  // there are only two inputs
+  BOOST_CHECK_THROW(summer->bind(2), ExceptionAbort);
+  BOOST_CHECK_EQUAL(summer->inputKey(1), "half");
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_begin_threads )
+{
+  std::vector<InputModule::Status> states;
+  states.push_back(InputModule::BeginRun);
+  states.push_back(InputModule::BeginCalibCycle);
+  states.insert(states.end(), 3, InputModule::DoEvent);
+  states.push_back(InputModule::EndCalibCycle);
+  states.push_back(InputModule::EndRun);
+
+  // three detectors are independent and produce nothing, P adds data to
+  // transition event and is called alone, D needs data from P
+  BeginTracker tracker;
+  std::vector<boost::shared_ptr<Module> > modules;
+  modules.push_back(boost::make_shared<CalibModule>("A", "rawA", "", boost::ref(tracker)));
+  modules.push_back(boost::make_shared<CalibModule>("B", "rawB", "", boost::ref(tracker)));
+  modules.push_back(boost::make_shared<CalibModule>("C", "rawC", "", boost::ref(tracker)));
+  modules.push_back(boost::make_shared<CalibModule>("P", "rawP", "calibP", boost::ref(tracker)));
+  modules.push_back(boost::make_shared<CalibModule>("D", "calibP", "", boost::ref(tracker)));
+  boost::shared_ptr<CountingModule> counter = boost::make_shared<CountingModule>();
+  modules.push_back(counter);
+  Fixture f(&states[0], states.size(), modules);
+  f.evtLoop->setBeginThreads(4);
+
+  EventLoop::value_type evt;
+  while ((evt = f.evtLoop->next()).first != EventLoop::BeginRun) {}
+
+  // all modules finished beginRun
+  BOOST_CHECK_EQUAL(tracker.active, 0);
+  BOOST_CHECK_EQUAL(tracker.maxActive, 3);
+  BOOST_CHECK_EQUAL(counter->nBeginRun, 1);
+  BOOST_REQUIRE_EQUAL(tracker.order.size(), 5U);
+  BOOST_CHECK_EQUAL(tracker.order.back(), "D");
+  BOOST_CHECK(evt.second->exists<int>("calibP"));
+
+  while (f.evtLoop->next().first != EventLoop::None) {}
+  BOOST_CHECK_EQUAL(counter->nEvent, 3);
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_begin_threads_undeclared )
+{
+  std::vector<InputModule::Status> states;
+  states.push_back(InputModule::BeginRun);
+  states.push_back(InputModule::BeginCalibCycle);
+  states.insert(states.end(), 3, InputModule::DoEvent);
+  states.push_back(InputModule::EndCalibCycle);
+  states.push_back(InputModule::EndRun);
+
+  // module adds data which it did not declare while running in parallel
+  BeginTracker tracker;
+  std::vector<boost::shared_ptr<Module> > modules;
+  modules.push_back(boost::make_shared<CalibModule>("A", "rawA", "", boost::ref(tracker)));
+  boost::shared_ptr<CalibModule> bad = boost::make_shared<CalibModule>("B", "rawB", "", boost::ref(tracker));
+  bad->undeclared = "calibB";
+  modules.push_back(bad);
+  Fixture f(&states[0], states.size(), modules);
+  f.evtLoop->setBeginThreads(2);
+
+  BOOST_CHECK_EQUAL(f.evtLoop->next().first, EventLoop::BeginJob);
+  BOOST_CHECK_THROW(f.evtLoop->next(), ExceptionAbort);
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_product_cache )
+{
+  std::vector<InputModule::Status> states;
+  states.push_back(InputModule::BeginRun);
+  states.push_back(InputModule::BeginCalibCycle);
+  states.insert(states.end(), 6, InputModule::DoEvent);
+  states.push_back(InputModule::EndCalibCycle);
+  states.push_back(InputModule::EndRun);
+
+  char dirTemplate[] = "/tmp/psana-cache-XXXXXX";
+  const char* dir = mkdtemp(dirTemplate);
+  BOOST_REQUIRE(dir);
+
+  // first pass fills the cache, second pass restores products from it;
+  // files are renamed in between as if they were written by other process
+  for (int pass = 0; pass != 2; ++ pass) {
+    if (pass > 0) {
+      std::string cmd = std::string("cd ") + dir + " && for f in *.cache; do mv \"$f\" \"${f%%.*}.otherhost-1.cache\"; done";
+      BOOST_CHECK_EQUAL(system(cmd.c_str()), 0);
+    }
+
+    std::vector<boost::shared_ptr<Module> > modules;
+    modules.push_back(boost::make_shared<EventIdModule>());
+    boost::shared_ptr<SquareModule> square = boost::make_shared<SquareModule>();
+    modules.push_back(square);
+    boost::shared_ptr<SquareSumModule> summer = boost::make_shared<SquareSumModule>();
+    modules.push_back(summer);
+    Fixture f(&states[0], states.size(), modules);
+    f.evtLoop->setProductCache(dir);
+
+    while (f.evtLoop->next().first != EventLoop::None) {}
+
+    BOOST_CHECK_EQUAL(square->nEvent, pass == 0 ? 6 : 0);
+    // odd events are skipped, cached status is restored too
+    BOOST_CHECK_EQUAL(summer->nEvent, 3);
+    BOOST_CHECK_EQUAL(summer->sum, 4 + 16 + 36);
+  }
+
+  std::string cmd = std::string("rm -rf ") + dir;
+  BOOST_CHECK_EQUAL(system(cmd.c_str()), 0);
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_checkpoint )
+{
+  std::vector<InputModule::Status> states;
+  states.push_back(InputModule::BeginRun);
+  for (int i = 0; i != 3; ++ i) {
+    states.push_back(InputModule::BeginCalibCycle);
+    states.insert(states.end(), 4, InputModule::DoEvent);
+    states.push_back(InputModule::EndCalibCycle);
+  }
+  states.push_back(InputModule::EndRun);
+
+  char fileTemplate[] = "/tmp/psana-checkpoint-XXXXXX";
+  int fd = mkstemp(fileTemplate);
+  BOOST_REQUIRE(fd >= 0);
+  close(fd);
+  unlink(fileTemplate);
+  const std::string path = fileTemplate;
+
+  // first job dies after second calib cycle; module with the same name in
+  // other chain sees all events and has its own state
+  {
+    boost::shared_ptr<RestartableInputModule> input = boost::make_shared<RestartableInputModule>(&states[0], states.size());
+    std::vector<boost::shared_ptr<Module> > modules;
+    modules.push_back(boost::make_shared<SkippingModule>());
+    boost::shared_ptr<CheckpointModule> module = boost::make_shared<CheckpointModule>();
+    modules.push_back(module);
+    Fixture f(&states[0], states.size(), modules, input);
+    boost::shared_ptr<CheckpointModule> other = boost::make_shared<CheckpointModule>();
+    f.evtLoop->addChain("other", std::vector<boost::shared_ptr<Module> >(1, other));
+    f.evtLoop->setCheckpoint(path, 2);
+    f.evtLoop->setResume(path);
+
+    int nSteps = 0;
+    EventLoop::EventType type;
+    while ((type = f.evtLoop->next().first) != EventLoop::None) {
+      if (type == EventLoop::EndCalibCycle and ++ nSteps == 2) break;
+    }
+    BOOST_CHECK_EQUAL(input->nJump, 0);
+    BOOST_CHECK_EQUAL(module->total, 4);
+    BOOST_CHECK_EQUAL(other->total, 8);
+  }
+
+  // restarted job only reads the last calib cycle
+  {
+    boost::shared_ptr<RestartableInputModule> input = boost::make_shared<RestartableInputModule>(&states[0], states.size());
+    std::vector<boost::shared_ptr<Module> > modules;
+    modules.push_back(boost::make_shared<SkippingModule>());
+    boost::shared_ptr<CheckpointModule> module = boost::make_shared<CheckpointModule>();
+    modules.push_back(module);
+    Fixture f(&states[0], states.size(), modules, input);
+    boost::shared_ptr<CheckpointModule> other = boost::make_shared<CheckpointModule>();
+    f.evtLoop->addChain("other", std::vector<boost::shared_ptr<Module> >(1, other));
+    f.evtLoop->setResume(path);
+
+    while (f.evtLoop->next().first != EventLoop::None) {}
+    BOOST_CHECK_EQUAL(input->nJump, 1);
+    BOOST_CHECK_EQUAL(module->nEvent, 2);
+    BOOST_CHECK_EQUAL(module->total, 6);
+    BOOST_CHECK_EQUAL(other->nEvent, 4);
+    BOOST_CHECK_EQUAL(other->total, 12);
+  }
+
+  // corrupted checkpoint with huge string size is rejected without allocating it
+  {
+    std::ofstream out(path.c_str(), std::ios::binary);
+    const uint64_t values[] = { 1, 1, uint64_t(1) << 60 };
+    out.write("PSCKPT01", 8);
+    out.write((const char*)values, sizeof values);
+  }
+  {
+    boost::shared_ptr<RestartableInputModule> input = boost::make_shared<RestartableInputModule>(&states[0], states.size());
+    Fixture f(&states[0], states.size(), std::vector<boost::shared_ptr<Module> >(), input);
+    f.evtLoop->setResume(path);
+    BOOST_CHECK_THROW(f.evtLoop->next(), ExceptionAbort);
+  }
+
+  unlink(path.c_str());
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_time_window )
+{
+  std::vector<InputModule::Status> states;
+  for (int run = 0; run != 2; ++ run) {
+    states.push_back(InputModule::BeginRun);
+    states.push_back(InputModule::BeginCalibCycle);
+    states.insert(states.end(), 10, InputModule::DoEvent);
+    states.push_back(InputModule::EndCalibCycle);
+    states.push_back(InputModule::EndRun);
+  }
+
+  // only events 3, 4 and 5 of every run are read
+  {
+    boost::shared_ptr<WindowInputModule> input = boost::make_shared<WindowInputModule>(&states[0], states.size());
+    boost::shared_ptr<CountingModule> counter = boost::make_shared<CountingModule>();
+    Fixture f(&states[0], states.size(), std::vector<boost::shared_ptr<Module> >(1, counter), input);
+    f.evtLoop->setTimeWindow(EventTime(uint64_t(1003) << 32, 0), EventTime(uint64_t(1006) << 32, 0));
+
+    while (f.evtLoop->next().first != EventLoop::None) {}
+    BOOST_CHECK_EQUAL(input->nSelect, 2);
+    BOOST_CHECK_EQUAL(counter->nBeginRun, 2);
+    BOOST_CHECK_EQUAL(counter->nEvent, 6);
+  }
+
+  // input without index cannot select window
+  {
+    Fixture f(&states[0], states.size(), std::vector<boost::shared_ptr<Module> >());
+    f.evtLoop->setTimeWindow(EventTime(uint64_t(1003) << 32, 0), EventTime(uint64_t(1006) << 32, 0));
+    BOOST_CHECK_EQUAL(f.evtLoop->next().first, EventLoop::BeginJob);
+    BOOST_CHECK_THROW(f.evtLoop->next(), ExceptionAbort);
+  }
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_event_join )
+{
+  std::vector<InputModule::Status> states;
+  states.push_back(InputModule::BeginRun);
+  states.push_back(InputModule::BeginCalibCycle);
+  states.insert(states.end(), 10, InputModule::DoEvent);
+  states.push_back(InputModule::EndCalibCycle);
+  states.push_back(InputModule::EndRun);
+
+  // second stream has every other event and is 500 ns late
+  const uint64_t tolerances[] = { 1000, 100 };
+  const unsigned nMatches[] = { 5, 0 };
+  for (unsigned i = 0; i != 2; ++ i) {
+    std::vector<boost::shared_ptr<Module> > modules1(1, boost::make_shared<EventIdModule>(1, 1));
+    std::vector<boost::shared_ptr<Module> > modules2(1, boost::make_shared<EventIdModule>(2, 2, 500));
+    Fixture f1(&states[0], states.size(), modules1);
+    Fixture f2(&states[0], states.size(), modules2);
+
+    EventJoin join(EventIter(f1.evtLoop, EventLoop::None), EventIter(f2.evtLoop, EventLoop::None), tolerances[i]);
+    unsigned count = 0;
+    EventJoin::value_type evts;
+    while ((evts = join.next()).first) {
+      ++ count;
+      boost::shared_ptr<PSEvt::EventId> eid1 = evts.first->get();
+      boost::shared_ptr<PSEvt::EventId> eid2 = evts.second->get();
+      BOOST_CHECK_EQUAL(eid1->fiducials(), eid2->fiducials());
+      BOOST_CHECK_EQUAL(eid1->vector(), 2 * count);
+    }
+    BOOST_CHECK_EQUAL(count, nMatches[i]);
+    BOOST_CHECK_EQUAL(join.nUnmatched1() + count, 10U);
+    BOOST_CHECK(not join.next().first);
+  }
+}
@@ -0,0 +1,99 @@
+//--------------------------------------------------------------------------
+// File and Version Information:
+// 	$Id$
+//
+// Description:
+//	Test suite case for the EventTimeArrayTest.
+//
+//------------------------------------------------------------------------
+
+//---------------
+// C++ Headers --
+//---------------
+#include <vector>
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+#include "psana/EventTimeArray.h"
+
+using namespace psana ;
+
+#define BOOST_TEST_MODULE EventTimeArrayTest
+#include <boost/test/included/unit_test.hpp>
+
+/**
+ * Simple test suite for class EventTimeArray.
+ * See http://www.boost.org/doc/libs/1_36_0/libs/test/doc/html/index.html
+ */
+
+namespace {
+
+EventTime eventTime(uint32_t sec, uint32_t nsec, uint32_t fiducial)
+{
+  return EventTime((uint64_t(sec) << 32) | nsec, fiducial);
+}
+
+// 120 Hz events, 1000 events over several seconds
+std::vector<EventTime> makeTimes(uint32_t offsetNs)
+{
+  std::vector<EventTime> times;
+  for (uint32_t i = 0; i != 1000; ++ i) {
+    const uint64_t ns = uint64_t(i) * 8333333 + offsetNs;
+    times.push_back(eventTime(1000 + ns / 1000000000, ns % 1000000000, 3 * i));
+  }
+  return times;
+}
+
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_search )
+{
+  const std::vector<EventTime> times = makeTimes(0);
+  EventTimeArray array(times.begin(), times.end());
+  BOOST_REQUIRE_EQUAL(array.size(), times.size());
+
+  // every time is found at its position, compare with scalar search
+  for (size_t i = 0; i != times.size(); ++ i) {
+    BOOST_CHECK_EQUAL(array.lowerBound(times[i]), i);
+    BOOST_CHECK_EQUAL(array.find(times[i]), i);
+  }
+  BOOST_CHECK_EQUAL(array[10].fiducial(), 30U);
+
+  // times in between and outside the range
+  BOOST_CHECK_EQUAL(array.lowerBound(eventTime(1000, 1, 0)), 1U);
+  BOOST_CHECK_EQUAL(array.lowerBound(eventTime(999, 0, 0)), 0U);
+  BOOST_CHECK_EQUAL(array.lowerBound(eventTime(2000, 0, 0)), times.size());
+
+  // wrong fiducial or time is not found
+  BOOST_CHECK_EQUAL(array.find(eventTime(times[5].seconds(), times[5].nanoseconds(), 1)), EventTimeArray::npos);
+  BOOST_CHECK_EQUAL(array.find(eventTime(1000, 1, 3)), EventTimeArray::npos);
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_match )
+{
+  // second stream is 1 us late and misses every tenth event
+  const std::vector<EventTime> times1 = makeTimes(0);
+  std::vector<EventTime> times2 = makeTimes(1000);
+  std::vector<EventTime> sparse;
+  for (size_t i = 0; i != times2.size(); ++ i) {
+    if (i % 10 != 0) sparse.push_back(times2[i]);
+  }
+  EventTimeArray array1(times1.begin(), times1.end());
+  EventTimeArray array2(sparse.begin(), sparse.end());
+
+  BOOST_CHECK_EQUAL(array2.findNearest(times1[1], 2000), 0U);
+  BOOST_CHECK_EQUAL(array2.findNearest(times1[1], 500), EventTimeArray::npos);
+  BOOST_CHECK_EQUAL(array2.findNearest(times1[10], 2000), EventTimeArray::npos);
+
+  std::vector<std::pair<size_t, size_t> > matches;
+  BOOST_CHECK_EQUAL(array1.match(array2, 2000, matches), 900U);
+  BOOST_REQUIRE_EQUAL(matches.size(), 900U);
+  for (size_t k = 0; k != matches.size(); ++ k) {
+    BOOST_CHECK_EQUAL(array1[matches[k].first].fiducial(), array2[matches[k].second].fiducial());
+  }
+}
@@ -18,6 +18,7 @@
 //-------------------------------
 // Collaborating Class Headers --
 //-------------------------------
+#include "psana/Exceptions.h"
 #include "psana/InputIter.h"
 #include "psana/InputModule.h"
 #include "PSEnv/Env.h"
@@ -56,20 +57,85 @@ public:
   
   virtual void endJob(Event& evt, Env& env) {}
 
+  virtual bool updatesEnv() const { return false; }
+
 private:
   
   std::deque<psana::InputModule::Status> m_states;  
 };
 
+// Input module which updates environment, read-ahead cannot be used with it
+class EnvInputModule: public TestInputModule {
+public:
+
+  EnvInputModule(const InputModule::Status states[], int nstates) : TestInputModule(states, nstates) {}
+
+  virtual bool updatesEnv() const { return true; }
+};
+
+// Input module which throws exception which is not std::exception
+class ThrowingInputModule: public TestInputModule {
+public:
+
+  ThrowingInputModule(const InputModule::Status states[], int nstates) : TestInputModule(states, nstates) {}
+
+  virtual Status event(Event& evt, Env& env) {
+    Status stat = TestInputModule::event(evt, env);
+    if (stat == DoEvent) throw 42;
+    return stat;
+  }
+};
+
+// Asynchronous input module which records number of reads in flight
+class AsyncTestInputModule: public AsyncInputModule {
+public:
+
+  AsyncTestInputModule(const InputModule::Status states[], int nstates)
+    : AsyncInputModule("AsyncTestInputModule"), maxInFlight(0)
+  {
+    std::copy(states, states+nstates, std::back_inserter(m_states));
+  }
+
+  virtual void beginJob(Event& evt, Env& env) {}
+  virtual void endJob(Event& evt, Env& env) {}
+
+  unsigned maxInFlight;
+
+protected:
+
+  virtual unsigned doSubmit(unsigned nEvents) {
+    unsigned n = 0;
+    for ( ; n != nEvents and not m_states.empty(); ++ n) {
+      m_inFlight.push_back(m_states.front());
+      m_states.pop_front();
+    }
+    maxInFlight = std::max(maxInFlight, unsigned(m_inFlight.size()));
+    return n;
+  }
+
+  virtual Status doComplete(Event& evt, Env& env) {
+    InputModule::Status state = m_inFlight.front();
+    m_inFlight.pop_front();
+    return state;
+  }
+
+private:
+
+  std::deque<psana::InputModule::Status> m_states;
+  std::deque<psana::InputModule::Status> m_inFlight;
+};
+
 struct Fixture {
   
-  Fixture(const InputModule::Status states[], int nstates, InputIter::EventType expected[], unsigned nexpected) 
+  Fixture(const InputModule::Status states[], int nstates, InputIter::EventType expected[], unsigned nexpected,
+      unsigned readAhead = 0, boost::shared_ptr<InputModule> input = boost::shared_ptr<InputModule>())
   {
     boost::shared_ptr<AliasMap> amap = boost::make_shared<AliasMap>();
     boost::shared_ptr<PSEnv::IExpNameProvider> expNameProvider;
     boost::shared_ptr<PSEnv::Env> env = boost::make_shared<PSEnv::Env>("", expNameProvider, "", amap, 0);
-    boost::shared_ptr<InputModule> input = boost::make_shared<TestInputModule>(states, nstates);
+    if (not input) input = boost::make_shared<TestInputModule>(states, nstates);
     iter = boost::make_shared<InputIter>(input, env);
+    iter->setReadAhead(readAhead);
     std::copy(expected, expected+nexpected, std::back_inserter(exp));
 
   }
@@ -377,3 +443,249 @@ BOOST_AUTO_TEST_CASE( test_8 )
 
 // ==============================================================
 
+BOOST_AUTO_TEST_CASE( test_readahead_1 )
+{
+  InputModule::Status states[] = {
+      InputModule::BeginRun,
+      InputModule::Skip,
+      InputModule::BeginCalibCycle,
+      InputModule::Skip,
+      InputModule::DoEvent,
+      InputModule::Skip,
+      InputModule::DoEvent,
+      InputModule::Skip,
+      InputModule::EndCalibCycle,
+      InputModule::Skip,
+      InputModule::EndRun,
+  };
+  InputIter::EventType expected[] = {
+      InputIter::BeginJob,
+      InputIter::BeginRun,
+      InputIter::BeginCalibCycle,
+      InputIter::Event,
+      InputIter::Event,
+      InputIter::EndCalibCycle,
+      InputIter::EndRun,
+      InputIter::EndJob,
+      InputIter::None,
+  };
+
+  Fixture f(states, sizeof states/sizeof states[0], expected, sizeof expected/sizeof expected[0], 1);
+  BOOST_CHECK(f.checkResult());
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_readahead_2 )
+{
+  InputModule::Status states[] = {
+      InputModule::BeginRun,
+      InputModule::BeginCalibCycle,
+      InputModule::DoEvent,
+      InputModule::DoEvent,
+      InputModule::BeginRun,
+      InputModule::DoEvent,
+      InputModule::DoEvent,
+      InputModule::EndCalibCycle,
+      InputModule::EndRun,
+  };
+  InputIter::EventType expected[] = {
+      InputIter::BeginJob,
+      InputIter::BeginRun,
+      InputIter::BeginCalibCycle,
+      InputIter::Event,
+      InputIter::Event,
+      InputIter::EndCalibCycle,
+      InputIter::EndRun,
+      InputIter::BeginRun,
+      InputIter::BeginCalibCycle,
+      InputIter::Event,
+      InputIter::Event,
+      InputIter::EndCalibCycle,
+      InputIter::EndRun,
+      InputIter::EndJob,
+      InputIter::None,
+  };
+
+  Fixture f(states, sizeof states/sizeof states[0], expected, sizeof expected/sizeof expected[0], 4);
+  BOOST_CHECK(f.checkResult());
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_readahead_finish )
+{
+  InputModule::Status states[] = {
+      InputModule::BeginRun,
+      InputModule::BeginCalibCycle,
+      InputModule::DoEvent,
+      InputModule::DoEvent,
+      InputModule::DoEvent,
+      InputModule::DoEvent,
+      InputModule::EndCalibCycle,
+      InputModule::EndRun,
+  };
+  InputIter::EventType expected[] = {
+      InputIter::BeginJob,
+      InputIter::BeginRun,
+      InputIter::BeginCalibCycle,
+      InputIter::Event,
+      InputIter::EndCalibCycle,
+      InputIter::EndRun,
+      InputIter::EndJob,
+      InputIter::None,
+  };
+
+  // stopping in the middle discards events that were read ahead
+  Fixture f(states, sizeof states/sizeof states[0], expected, sizeof expected/sizeof expected[0], 2);
+  std::vector<InputIter::EventType> res;
+  for (int i = 0; i != 4; ++ i) res.push_back(f.iter->next().first);
+  f.iter->finish();
+  std::vector<InputIter::EventType> rest = f.readAll();
+  res.insert(res.end(), rest.begin(), rest.end());
+  BOOST_CHECK(res == f.exp);
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_readahead_env )
+{
+  InputModule::Status states[] = {
+      InputModule::BeginRun,
+      InputModule::BeginCalibCycle,
+      InputModule::DoEvent,
+      InputModule::EndCalibCycle,
+      InputModule::EndRun,
+  };
+  InputIter::EventType expected[] = {
+      InputIter::BeginJob,
+      InputIter::BeginRun,
+      InputIter::BeginCalibCycle,
+      InputIter::Event,
+      InputIter::EndCalibCycle,
+      InputIter::EndRun,
+      InputIter::EndJob,
+      InputIter::None,
+  };
+
+  // input which updates environment is read synchronously
+  boost::shared_ptr<InputModule> input = boost::make_shared<EnvInputModule>(states, sizeof states/sizeof states[0]);
+  Fixture f(states, sizeof states/sizeof states[0], expected, sizeof expected/sizeof expected[0], 2, input);
+  BOOST_CHECK_EQUAL(f.iter->readAheadDepth(), 0U);
+  BOOST_CHECK(f.checkResult());
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_readahead_exception )
+{
+  InputModule::Status states[] = {
+      InputModule::BeginRun,
+      InputModule::BeginCalibCycle,
+      InputModule::DoEvent,
+      InputModule::EndCalibCycle,
+      InputModule::EndRun,
+  };
+
+  // any exception in reading thread is reported as abort
+  boost::shared_ptr<InputModule> input = boost::make_shared<ThrowingInputModule>(states, sizeof states/sizeof states[0]);
+  Fixture f(states, sizeof states/sizeof states[0], 0, 0, 2, input);
+  BOOST_CHECK_EQUAL(f.iter->readAheadDepth(), 2U);
+  BOOST_CHECK_EQUAL(f.iter->next().first, InputIter::BeginJob);
+  BOOST_CHECK_EQUAL(f.iter->next().first, InputIter::BeginRun);
+  BOOST_CHECK_EQUAL(f.iter->next().first, InputIter::BeginCalibCycle);
+  BOOST_CHECK_THROW(f.iter->next(), ExceptionAbort);
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_event_pool )
+{
+  InputModule::Status states[] = {
+      InputModule::BeginRun,
+      InputModule::BeginCalibCycle,
+      InputModule::DoEvent,
+      InputModule::DoEvent,
+      InputModule::DoEvent,
+      InputModule::DoEvent,
+      InputModule::EndCalibCycle,
+      InputModule::EndRun,
+  };
+  InputIter::EventType expected[] = {
+      InputIter::BeginJob,
+      InputIter::BeginRun,
+      InputIter::BeginCalibCycle,
+      InputIter::Event,
+      InputIter::Event,
+      InputIter::Event,
+      InputIter::Event,
+      InputIter::EndCalibCycle,
+      InputIter::EndRun,
+      InputIter::EndJob,
+      InputIter::None,
+  };
+
+  Fixture f(states, sizeof states/sizeof states[0], expected, sizeof expected/sizeof expected[0]);
+  f.iter->setEventPoolSize(4);
+
+  // every event is released before next one is read, reused events must be empty
+  std::vector<InputIter::EventType> res;
+  unsigned nNotEmpty = 0;
+  for (InputIter::value_type val = f.iter->next(); ; val = f.iter->next()) {
+    res.push_back(val.first);
+    if (val.first == InputIter::None) break;
+    if (not val.second->keys().empty()) ++ nNotEmpty;
+    val.second->put(boost::make_shared<int>(1), "data");
+  }
+  BOOST_CHECK(res == f.exp);
+  BOOST_CHECK_EQUAL(nNotEmpty, 0U);
+  BOOST_CHECK(f.iter->eventPool().nReused() > 0);
+  BOOST_CHECK(f.iter->eventPool().nCreated() < 5);
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_async )
+{
+  InputModule::Status states[] = {
+      InputModule::BeginRun,
+      InputModule::BeginCalibCycle,
+      InputModule::DoEvent,
+      InputModule::DoEvent,
+      InputModule::DoEvent,
+      InputModule::DoEvent,
+      InputModule::EndCalibCycle,
+      InputModule::EndRun,
+  };
+  InputIter::EventType expected[] = {
+      InputIter::BeginJob,
+      InputIter::BeginRun,
+      InputIter::BeginCalibCycle,
+      InputIter::Event,
+      InputIter::Event,
+      InputIter::Event,
+      InputIter::Event,
+      InputIter::EndCalibCycle,
+      InputIter::EndRun,
+      InputIter::EndJob,
+      InputIter::None,
+  };
+
+  // one read at a time by default
+  {
+    boost::shared_ptr<AsyncTestInputModule> input = boost::make_shared<AsyncTestInputModule>(states, sizeof states/sizeof states[0]);
+    Fixture f(states, sizeof states/sizeof states[0], expected, sizeof expected/sizeof expected[0], 0, input);
+    BOOST_CHECK(f.checkResult());
+    BOOST_CHECK_EQUAL(input->maxInFlight, 1U);
+  }
+
+  // several reads in flight, order is preserved
+  {
+    boost::shared_ptr<AsyncTestInputModule> input = boost::make_shared<AsyncTestInputModule>(states, sizeof states/sizeof states[0]);
+    Fixture f(states, sizeof states/sizeof states[0], expected, sizeof expected/sizeof expected[0], 0, input);
+    f.iter->setAsyncDepth(3);
+    BOOST_CHECK(f.checkResult());
+    BOOST_CHECK_EQUAL(input->maxInFlight, 3U);
+    BOOST_CHECK_EQUAL(input->outstanding(), 0U);
+  }
+}
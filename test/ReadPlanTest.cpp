@@ -0,0 +1,98 @@
+//--------------------------------------------------------------------------
+// File and Version Information:
+// 	$Id$
+//
+// Description:
+//	Test suite case for the ReadPlanTest.
+//
+//------------------------------------------------------------------------
+
+//---------------
+// C++ Headers --
+//---------------
+#include <string>
+#include <vector>
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+#include "psana/ReadPlan.h"
+
+using namespace psana ;
+
+#define BOOST_TEST_MODULE ReadPlanTest
+#include <boost/test/included/unit_test.hpp>
+
+/**
+ * Simple test suite for class ReadPlan.
+ * See http://www.boost.org/doc/libs/1_36_0/libs/test/doc/html/index.html
+ */
+
+namespace {
+
+RandomAccess::Position position(const std::string& file1, int64_t offset1,
+    const std::string& file2 = std::string(), int64_t offset2 = 0)
+{
+  RandomAccess::Position pos;
+  pos.filenames.push_back(file1);
+  pos.offsets.push_back(offset1);
+  if (not file2.empty()) {
+    pos.filenames.push_back(file2);
+    pos.offsets.push_back(offset2);
+  }
+  return pos;
+}
+
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_merge )
+{
+  // gap 100, max size 1000, datagrams up to 50 bytes
+  ReadPlan plan(100, 1000, 50);
+  BOOST_CHECK_EQUAL(plan.add(position("a.xtc", 500, "b.xtc", 10)), 0U);
+  BOOST_CHECK_EQUAL(plan.add(position("a.xtc", 100, "b.xtc", 5000)), 1U);
+  BOOST_CHECK_EQUAL(plan.add(position("a.xtc", 200)), 2U);
+  BOOST_CHECK_EQUAL(plan.add(position("a.xtc", 5000)), 3U);
+  BOOST_CHECK_EQUAL(plan.size(), 4U);
+
+  std::vector<ReadPlan::Read> reads = plan.reads();
+  BOOST_REQUIRE_EQUAL(reads.size(), 5U);
+
+  // 100 and 200 are merged, 500 is too far from 250
+  BOOST_CHECK_EQUAL(reads[0].filename, "a.xtc");
+  BOOST_CHECK_EQUAL(reads[0].begin, 100);
+  BOOST_CHECK_EQUAL(reads[0].end, 250);
+  BOOST_REQUIRE_EQUAL(reads[0].pieces.size(), 2U);
+  BOOST_CHECK_EQUAL(reads[0].pieces[0].event, 1U);
+  BOOST_CHECK_EQUAL(reads[0].pieces[1].event, 2U);
+
+  BOOST_CHECK_EQUAL(reads[1].begin, 500);
+  BOOST_CHECK_EQUAL(reads[1].pieces[0].event, 0U);
+  BOOST_CHECK_EQUAL(reads[2].begin, 5000);
+  BOOST_CHECK_EQUAL(reads[2].pieces[0].event, 3U);
+
+  // second file of the events
+  BOOST_CHECK_EQUAL(reads[3].filename, "b.xtc");
+  BOOST_CHECK_EQUAL(reads[3].begin, 10);
+  BOOST_CHECK_EQUAL(reads[3].pieces[0].file, 1U);
+  BOOST_CHECK_EQUAL(reads[4].begin, 5000);
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_max_size )
+{
+  // adjacent datagrams are not merged beyond maximum read size
+  ReadPlan plan(100, 200, 50);
+  for (int i = 0; i != 10; ++ i) plan.add(position("a.xtc", 50 * i));
+
+  std::vector<ReadPlan::Read> reads = plan.reads();
+  BOOST_REQUIRE_EQUAL(reads.size(), 3U);
+  BOOST_CHECK_EQUAL(reads[0].begin, 0);
+  BOOST_CHECK_EQUAL(reads[0].end, 200);
+  BOOST_CHECK_EQUAL(reads[0].pieces.size(), 4U);
+  BOOST_CHECK_EQUAL(reads[2].end, 500);
+  BOOST_CHECK_EQUAL(reads[2].pieces.size(), 2U);
+}
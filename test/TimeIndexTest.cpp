@@ -0,0 +1,156 @@
+//--------------------------------------------------------------------------
+// File and Version Information:
+// 	$Id$
+//
+// Description:
+//	Test suite case for the TimeIndexTest.
+//
+//------------------------------------------------------------------------
+
+//---------------
+// C++ Headers --
+//---------------
+#include <stdlib.h>
+#include <unistd.h>
+#include <fstream>
+#include <string>
+
+//-------------------------------
+// Collaborating Class Headers --
+//-------------------------------
+#include "psana/Exceptions.h"
+#include "psana/TimeIndex.h"
+
+using namespace psana ;
+
+#define BOOST_TEST_MODULE TimeIndexTest
+#include <boost/test/included/unit_test.hpp>
+
+/**
+ * Simple test suite for class TimeIndex.
+ * See http://www.boost.org/doc/libs/1_36_0/libs/test/doc/html/index.html
+ */
+
+namespace {
+
+// Makes unique file name and removes the file at the end
+struct TmpFile {
+  TmpFile() {
+    char name[] = "/tmp/psana-index-XXXXXX";
+    int fd = mkstemp(name);
+    if (fd >= 0) close(fd);
+    path = name;
+  }
+  ~TmpFile() { unlink(path.c_str()); }
+  std::string path;
+};
+
+EventTime eventTime(uint32_t sec, uint32_t nsec, uint32_t fiducial)
+{
+  return EventTime((uint64_t(sec) << 32) | nsec, fiducial);
+}
+
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_write_read )
+{
+  TmpFile tmp;
+
+  // two steps, events are not in time order within a step
+  TimeIndex::Writer writer;
+  writer.addRun(12);
+  writer.addStep();
+  writer.add(eventTime(100, 20, 6), 0, 2000);
+  writer.add(eventTime(100, 10, 3), 1, 1000);
+  writer.add(eventTime(100, 30, 9), 0, 3000);
+  writer.addStep();
+  writer.add(eventTime(101, 10, 12), 1, 4000);
+  writer.add(eventTime(101, 5, 12), 1, 3500);
+  writer.write(tmp.path);
+
+  TimeIndex index(tmp.path);
+  BOOST_CHECK_EQUAL(index.size(), 5U);
+  BOOST_CHECK_EQUAL(index.nsteps(), 2U);
+  BOOST_REQUIRE_EQUAL(index.runs().size(), 1U);
+  BOOST_CHECK_EQUAL(index.runs()[0], 12U);
+
+  const TimeIndex::Entry* entry = index.find(eventTime(100, 10, 3));
+  BOOST_REQUIRE(entry);
+  BOOST_CHECK_EQUAL(entry->file, 1U);
+  BOOST_CHECK_EQUAL(entry->offset, 1000);
+  entry = index.find(eventTime(101, 10, 12));
+  BOOST_REQUIRE(entry);
+  BOOST_CHECK_EQUAL(entry->offset, 4000);
+  BOOST_CHECK(not index.find(eventTime(100, 10, 4)));
+  BOOST_CHECK(not index.find(eventTime(99, 0, 0)));
+  BOOST_CHECK(not index.find(eventTime(200, 0, 0)));
+
+  Index::EventTimeIter begin, end;
+  index.times(begin, end);
+  BOOST_REQUIRE_EQUAL(end - begin, 5);
+  BOOST_CHECK_EQUAL(begin->nanoseconds(), 10U);
+  index.times(1, begin, end);
+  BOOST_REQUIRE_EQUAL(end - begin, 2);
+  BOOST_CHECK_EQUAL(begin->seconds(), 101U);
+  BOOST_CHECK_EQUAL(begin->nanoseconds(), 5U);
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_select )
+{
+  TmpFile tmp;
+
+  // events alternate between two files
+  TimeIndex::Writer writer;
+  for (unsigned i = 0; i != 10; ++ i) {
+    writer.add(eventTime(100 + i, 0, 3 * i), i % 2, 1000 * (i / 2));
+  }
+  writer.write(tmp.path);
+  TimeIndex index(tmp.path);
+
+  std::vector<TimeIndex::Span> spans;
+  BOOST_CHECK_EQUAL(index.select(eventTime(103, 0, 0), eventTime(108, 0, 0), spans), 5U);
+  BOOST_REQUIRE_EQUAL(spans.size(), 2U);
+  BOOST_CHECK_EQUAL(spans[0].file, 0U);
+  BOOST_CHECK_EQUAL(spans[0].begin, 2000);
+  BOOST_CHECK_EQUAL(spans[0].last, 3000);
+  BOOST_CHECK_EQUAL(spans[0].nEvents, 2U);
+  BOOST_CHECK_EQUAL(spans[1].file, 1U);
+  BOOST_CHECK_EQUAL(spans[1].begin, 1000);
+  BOOST_CHECK_EQUAL(spans[1].last, 3000);
+  BOOST_CHECK_EQUAL(spans[1].nEvents, 3U);
+
+  // window which contains only events from one file
+  BOOST_CHECK_EQUAL(index.select(eventTime(104, 0, 0), eventTime(104, 1, 0), spans), 1U);
+  BOOST_REQUIRE_EQUAL(spans.size(), 1U);
+  BOOST_CHECK_EQUAL(spans[0].file, 0U);
+
+  // empty window
+  BOOST_CHECK_EQUAL(index.select(eventTime(200, 0, 0), eventTime(300, 0, 0), spans), 0U);
+  BOOST_CHECK(spans.empty());
+}
+
+// ==============================================================
+
+BOOST_AUTO_TEST_CASE( test_bad_files )
+{
+  TmpFile tmp;
+
+  // steps overlapping in time
+  TimeIndex::Writer writer;
+  writer.addStep();
+  writer.add(eventTime(100, 20, 6), 0, 2000);
+  writer.addStep();
+  writer.add(eventTime(100, 10, 3), 0, 1000);
+  BOOST_CHECK_THROW(writer.write(tmp.path), ExceptionAbort);
+
+  // truncated file
+  TimeIndex::Writer good;
+  good.add(eventTime(100, 10, 3), 0, 1000);
+  good.write(tmp.path);
+  truncate(tmp.path.c_str(), 40);
+  BOOST_CHECK_THROW(TimeIndex index(tmp.path), ExceptionErrno);
+}